@@ -0,0 +1,220 @@
+#include "baseline.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+Error
+writeResults(const char *path, const Result *results, int n)
+{
+	FILE *out = fopen(path, "w");
+	if (!out) {
+		return ErrFile;
+	}
+
+	printHeader(out, FormatJson);
+	for (int r = 0; r < n; r++) {
+		printResult(out, FormatJson, &results[r], NULL, r == 0);
+	}
+	printFooter(out, FormatJson);
+
+	return fclose(out) == 0 ? OK : ErrFile;
+}
+
+/*
+ * Not a general JSON parser: writeResults puts every result on its own
+ * line, so the fields are looked up by key within the line.
+ */
+static const char *
+jsonValue(const char *line, const char *key)
+{
+	char pattern[MAX_NAME_LEN];
+	snprintf(pattern, MAX_NAME_LEN, "\"%s\": ", key);
+
+	const char *value = strstr(line, pattern);
+	return value ? value + strlen(pattern) : NULL;
+}
+
+static int
+jsonNumber(const char *line, const char *key, double *number)
+{
+	const char *value = jsonValue(line, key);
+	return value && sscanf(value, "%lf", number) == 1;
+}
+
+static int
+jsonString(const char *line, const char *key, char *str, int len)
+{
+	const char *value = jsonValue(line, key);
+	if (!value || *value != '"') {
+		return 0;
+	}
+
+	const char *end = strchr(++value, '"');
+	if (!end || end - value >= len) {
+		return 0;
+	}
+
+	memcpy(str, value, end - value);
+	str[end - value] = '\0';
+	return 1;
+}
+
+static int
+parseResult(const char *line, Result *result)
+{
+	double commSize = 0, bytes = 0, loops = 0, samples = 0, outliers = 0;
+
+	memset(result, 0, sizeof(*result));
+
+	/* results written before the split runs are all on the whole comm */
+	if (!jsonString(line, "scope", result->scope, MAX_SCOPE_LEN)) {
+		strcpy(result->scope, "world");
+	}
+
+	return jsonString(line, "name", result->name, MAX_NAME_LEN) &&
+	       jsonNumber(line, "comm_size", &commSize) &&
+	       jsonNumber(line, "bytes", &bytes) &&
+	       jsonNumber(line, "loops", &loops) &&
+	       jsonNumber(line, "samples", &samples) &&
+	       jsonNumber(line, "outliers", &outliers) &&
+	       jsonNumber(line, "median", &result->stats.median) &&
+	       jsonNumber(line, "p99", &result->stats.p99) &&
+	       jsonNumber(line, "mean", &result->stats.mean) &&
+	       jsonNumber(line, "stddev", &result->stats.stddev) &&
+	       (result->commSize = commSize, result->bytes = bytes, result->loops = loops,
+	        result->stats.n = samples, result->stats.outliers = outliers, 1);
+}
+
+#define MAX_LINE_LEN 65536
+
+Error
+loadResults(const char *path, Result **results, int *n)
+{
+	Error error = OK;
+	int max = 0;
+
+	*results = NULL;
+	*n = 0;
+
+	FILE *in = fopen(path, "r");
+	if (!in) {
+		return ErrFile;
+	}
+
+	char *line = (char *)malloc(MAX_LINE_LEN);
+	if (!line) {
+		fclose(in);
+		return ErrOutOfMemory;
+	}
+
+	while (error == OK && fgets(line, MAX_LINE_LEN, in)) {
+		if (!strchr(line, '{')) {
+			continue;
+		}
+
+		if (*n == max) {
+			max = max ? 2 * max : 64;
+			Result *more = (Result *)realloc(*results, max * sizeof(Result));
+			if (!more) {
+				error = ErrOutOfMemory;
+				break;
+			}
+			*results = more;
+		}
+
+		if (parseResult(line, &(*results)[*n])) {
+			(*n)++;
+		} else {
+			error = ErrFile;
+		}
+	}
+
+	free(line);
+	fclose(in);
+
+	if (error != OK) {
+		freeResults(*results, *n);
+		*results = NULL;
+		*n = 0;
+	}
+	return error;
+}
+
+static const Result *
+findResult(const Result *results, int n, const Result *key)
+{
+	for (int r = 0; r < n; r++) {
+		if (strcmp(results[r].name, key->name) == 0 && strcmp(results[r].scope, key->scope) == 0 &&
+		    results[r].commSize == key->commSize && results[r].bytes == key->bytes) {
+			return &results[r];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Welch's t statistic and the Welch-Satterthwaite degrees of freedom,
+ * over the inliers the mean and stddev were taken from
+ */
+static double
+welch(const Stats *a, const Stats *b, int *df)
+{
+	int na = a->n - a->outliers > 0 ? a->n - a->outliers : 1,
+	    nb = b->n - b->outliers > 0 ? b->n - b->outliers : 1;
+	double va = a->stddev * a->stddev / na,
+	       vb = b->stddev * b->stddev / nb;
+
+	if (va + vb == 0) {
+		*df = 1;
+		return a->mean == b->mean ? 0 : copysign(INFINITY, a->mean - b->mean);
+	}
+
+	double dof = (va + vb) * (va + vb) /
+	             (va * va / (na > 1 ? na - 1 : 1) + vb * vb / (nb > 1 ? nb - 1 : 1));
+	*df = dof < 1 ? 1 : (int)dof;
+
+	return (a->mean - b->mean) / sqrt(va + vb);
+}
+
+int
+compareResults(const Result *base, int nBase, const Result *results, int n, double threshold, FILE *out)
+{
+	int regressions = 0;
+
+	fprintf(out, "Comparison against the baseline (threshold %.1f%%):\n", threshold * 100);
+
+	for (int r = 0; r < n; r++) {
+		const Result *result = &results[r];
+		const Result *before = findResult(base, nBase, result);
+		if (!before) {
+			fprintf(out, "%s (%d %s ranks, %d bytes):\tnot in the baseline\n",
+			        result->name, result->commSize, result->scope, result->bytes);
+			continue;
+		}
+
+		int df = 0;
+		double t = welch(&result->stats, &before->stats, &df);
+		double change = before->stats.mean > 0 ?
+		                result->stats.mean / before->stats.mean - 1 : 0;
+
+		const char *verdict = "same";
+		if (fabs(t) > tQuantile(df)) {
+			if (change > threshold) {
+				verdict = "SLOWER";
+				regressions++;
+			} else if (change < -threshold) {
+				verdict = "faster";
+			}
+		}
+
+		fprintf(out, "%s (%d %s ranks, %d bytes):\tmean %.9f -> %.9f seconds (%+.1f%%, t = %.2f), %s\n",
+		        result->name, result->commSize, result->scope, result->bytes, before->stats.mean,
+		        result->stats.mean, change * 100, t, verdict);
+	}
+
+	fprintf(out, "%d regression(s)\n", regressions);
+	fflush(out);
+
+	return regressions;
+}
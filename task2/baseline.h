@@ -0,0 +1,21 @@
+#ifndef __BASELINE_H__
+#define __BASELINE_H__
+
+#include "bench.h"
+
+/* reads a JSON result file written by writeResults */
+Error
+loadResults(const char *path, Result **results, int *n);
+
+Error
+writeResults(const char *path, const Result *results, int n);
+
+/*
+ * Matches results to the baseline by (name, scope, comm size, bytes) and flags
+ * the ones whose mean is slower by more than threshold (relative) with
+ * Welch's t-test significant at 95%. Returns the number of regressions.
+ */
+int
+compareResults(const Result *base, int nBase, const Result *results, int n, double threshold, FILE *out);
+
+#endif
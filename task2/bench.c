@@ -0,0 +1,1140 @@
+#include "bench.h"
+#include "baseline.h"
+#include "check.h"
+#include "kernel.h"
+#include "topology.h"
+#include "noise.h"
+#include "concurrent.h"
+#include "collectives.h"
+#include "schedule.h"
+#include "tuner.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+const char *
+message(Error error)
+{
+	switch (error) {
+		case OK:
+			return "success";
+		case ErrOutOfMemory:
+			return "out of memory";
+		case ErrInvalidArgs:
+			return "invalid arguments";
+		case ErrRegression:
+			return "performance regression against the baseline";
+		case ErrFile:
+			return "couldn't read or write a file";
+		case ErrMpi:
+			return "an MPI call failed";
+		case ErrThreadLevel:
+			return "the MPI library doesn't provide MPI_THREAD_MULTIPLE";
+		case ErrMismatch:
+			return "a custom collective's result differs from MPI's";
+		default:
+			return "unknown error";
+	}
+}
+
+#define MIB (1024L * 1024L)
+
+#define DEFAULT_MIN_SIZE  1
+#define DEFAULT_MAX_SIZE  (64 * MIB)
+#define DEFAULT_THRESHOLD 0.05
+
+#define DEFAULT_INTERFERENCE_THREADS 1
+#define DEFAULT_INTERFERENCE_SIZE    (64 * MIB)
+
+#define DEFAULT_NOISE_SAMPLES 2000
+#define DEFAULT_NOISE_QUANTUM 0.0001
+
+void
+usage(const char *prog)
+{
+	printf("The usage of %s is:\n", prog);
+	printf("%s [--config FILE] [--ops OP,...] [--sweep] [--min-size BYTES] [--max-size BYTES]\n", prog);
+	printf("   [--overlap] [--split] [--ranks-per-node N] [--noise] [--noise-samples N]\n");
+	printf("   [--noise-quantum SECONDS] [--interference memory|compute] [--interference-threads N]\n");
+	printf("   [--interference-size BYTES] [--concurrent N] [--concurrency threads|nonblocking]\n");
+	printf("   [--segment-size BYTES] [--progress-thread] [--tune-output FILE] [--decisions FILE]\n");
+	printf("   [--format text|csv|json] [--pause SECONDS] [--output FILE] [--baseline FILE] [--check]\n");
+	printf("  --config    read the options from FILE, one \"key value...\" per line, keys are\n");
+	printf("              ops, sizes, sweep, overlap, split, ranks_per_node, noise, noise_samples,\n");
+	printf("              noise_quantum, interference, interference_threads, interference_size,\n");
+	printf("              concurrent, concurrency, segment_size, progress_thread, tune_output,\n");
+	printf("              decisions, min_size, max_size, comm_sizes, warmup_loops, min_loops,\n");
+	printf("              max_loops, precision, pause, format, output, baseline, threshold and\n");
+	printf("              check,\n");
+	printf("              '#' starts a comment\n");
+	printf("  --sweep     run every benchmark from --min-size to --max-size in powers of two\n");
+	printf("              (%ld B to %ld MiB by default), otherwise on 1 byte\n",
+	       (long)DEFAULT_MIN_SIZE, DEFAULT_MAX_SIZE / MIB);
+	printf("  --overlap   also run the non-blocking ops with a compute kernel as long as the\n");
+	printf("              communication between post and wait and report the overlap achieved,\n");
+	printf("              runs all the non-blocking ops unless --ops is given\n");
+	printf("  --split     also run every op on the ranks of each node at once and on the node\n");
+	printf("              leaders, the node of rank 0 is reported\n");
+	printf("  --ranks-per-node\n");
+	printf("              emulate nodes of N consecutive ranks instead of the shared memory\n");
+	printf("              ones, for --split and the hierarchical collectives, implies --split\n");
+	printf("  --noise     measure the OS noise of every rank with %d fixed work and fixed time\n",
+	       DEFAULT_NOISE_SAMPLES);
+	printf("              quanta of %g seconds first and correlate it with the slowest ranks\n",
+	       DEFAULT_NOISE_QUANTUM);
+	printf("  --interference\n");
+	printf("              also run every series with background threads on each rank, a STREAM\n");
+	printf("              triad over %ld MiB or a compute spinner, %d per rank by default, and\n",
+	       DEFAULT_INTERFERENCE_SIZE / MIB, DEFAULT_INTERFERENCE_THREADS);
+	printf("              report the slowdown against the quiet run\n");
+	printf("  --concurrent\n");
+	printf("              also run every series with N instances in flight on duplicates of\n");
+	printf("              the comm, from as many threads or posted together if --concurrency\n");
+	printf("              is nonblocking, which only runs the non-blocking ops\n");
+	printf("  --segment-size\n");
+	printf("              segment of the pipelined bcast on long messages, %d KiB by default\n",
+	       bcastSegment / 1024);
+	printf("  --progress-thread\n");
+	printf("              progress the custom non-blocking ops from a thread while the caller\n");
+	printf("              computes, otherwise they only advance in wait\n");
+	printf("  --tune-output\n");
+	printf("              run every variant of the custom collectives, over the --sweep sizes\n");
+	printf("              unless --sizes is given, and write the fastest of each point to FILE\n");
+	printf("  --decisions make the custom collectives pick their variants from a FILE written\n");
+	printf("              by --tune-output\n");
+	printf("  --format    output format, text by default\n");
+	printf("  --pause     sleep between series of 100 loops, 0 by default\n");
+	printf("  --output    write the results to FILE as JSON\n");
+	printf("  --baseline  compare the results against a JSON result FILE, fail on slowdowns over\n");
+	printf("              the threshold (%.0f%% by default) significant at 95%%\n",
+	       DEFAULT_THRESHOLD * 100);
+	printf("  --check     instead of timing, run every custom collective on ints, vector columns\n");
+	printf("              and in place at the sizes and comm sizes given, fail if any result\n");
+	printf("              differs from the MPI one\n");
+	printf("Sizes accept K, M and G suffixes. Operations are:");
+	for (int b = 0; b < nBenchmarks; b++) {
+		printf(" %s", benchmarks[b].name);
+	}
+	printf("\n");
+}
+
+static int
+parseSize(const char *str, long *size)
+{
+	char *end = NULL;
+	long value = strtol(str, &end, 10);
+	if (end == str || value <= 0) {
+		return 0;
+	}
+
+	switch (*end) {
+		case 'K': case 'k':
+			value <<= 10, end++;
+			break;
+		case 'M': case 'm':
+			value <<= 20, end++;
+			break;
+		case 'G': case 'g':
+			value <<= 30, end++;
+			break;
+	}
+
+	*size = value;
+	return *end == '\0';
+}
+
+static int
+parseInt(const char *str, int *value)
+{
+	char *end = NULL;
+	long v = strtol(str, &end, 10);
+	if (end == str || *end != '\0' || v < 0 || v > INT_MAX) {
+		return 0;
+	}
+	*value = (int)v;
+	return 1;
+}
+
+static int
+parseDouble(const char *str, double *value)
+{
+	char *end = NULL;
+	*value = strtod(str, &end);
+	return end != str && *end == '\0' && *value >= 0;
+}
+
+static int
+addOp(Options *opts, const char *name)
+{
+	if (opts->nOps == MAX_OPS || !findBenchmark(name)) {
+		return 0;
+	}
+	strncpy(opts->ops[opts->nOps++], name, MAX_NAME_LEN - 1);
+	return 1;
+}
+
+/* applies "key value..." with the values split in vals */
+static Error
+setOption(Options *opts, const char *key, char **vals, int nVals)
+{
+	int ok = nVals > 0;
+
+	if (strcmp(key, "sweep") == 0) {
+		opts->sweep = 1;
+		return OK;
+	} else if (strcmp(key, "overlap") == 0) {
+		opts->overlap = 1;
+		return OK;
+	} else if (strcmp(key, "split") == 0) {
+		opts->split = 1;
+		return OK;
+	} else if (strcmp(key, "noise") == 0) {
+		opts->noise = 1;
+		return OK;
+	} else if (strcmp(key, "progress_thread") == 0) {
+		opts->progressThread = 1;
+		return OK;
+	} else if (strcmp(key, "check") == 0) {
+		opts->check = 1;
+		return OK;
+	} else if (strcmp(key, "ops") == 0) {
+		opts->nOps = 0;
+		for (int v = 0; v < nVals && ok; v++) {
+			ok = addOp(opts, vals[v]);
+		}
+	} else if (strcmp(key, "sizes") == 0) {
+		opts->nSizes = 0;
+		for (int v = 0; v < nVals && ok; v++) {
+			ok = opts->nSizes < MAX_SIZES && parseSize(vals[v], &opts->sizes[opts->nSizes++]);
+		}
+	} else if (strcmp(key, "comm_sizes") == 0) {
+		opts->nCommSizes = 0;
+		for (int v = 0; v < nVals && ok; v++) {
+			ok = opts->nCommSizes < MAX_COMM_SIZES &&
+			     parseInt(vals[v], &opts->commSizes[opts->nCommSizes++]);
+		}
+	} else if (nVals != 1) {
+		ok = 0;
+	} else if (strcmp(key, "min_size") == 0) {
+		ok = parseSize(vals[0], &opts->minSize);
+	} else if (strcmp(key, "max_size") == 0) {
+		ok = parseSize(vals[0], &opts->maxSize);
+	} else if (strcmp(key, "ranks_per_node") == 0) {
+		ok = parseInt(vals[0], &opts->ranksPerNode) && opts->ranksPerNode > 0;
+		opts->split = 1;
+	} else if (strcmp(key, "interference") == 0) {
+		if (strcmp(vals[0], "memory") == 0) {
+			opts->interference = LoadMemory;
+		} else if (strcmp(vals[0], "compute") == 0) {
+			opts->interference = LoadCompute;
+		} else {
+			ok = 0;
+		}
+	} else if (strcmp(key, "interference_threads") == 0) {
+		ok = parseInt(vals[0], &opts->interferenceThreads) && opts->interferenceThreads > 0;
+	} else if (strcmp(key, "interference_size") == 0) {
+		ok = parseSize(vals[0], &opts->interferenceSize);
+	} else if (strcmp(key, "concurrent") == 0) {
+		ok = parseInt(vals[0], &opts->concurrent) && opts->concurrent > 0;
+	} else if (strcmp(key, "concurrency") == 0) {
+		if (strcmp(vals[0], "threads") == 0) {
+			opts->concurrency = ConcurrencyThreads;
+		} else if (strcmp(vals[0], "nonblocking") == 0) {
+			opts->concurrency = ConcurrencyNonblocking;
+		} else {
+			ok = 0;
+		}
+	} else if (strcmp(key, "segment_size") == 0) {
+		ok = parseSize(vals[0], &opts->segmentSize) && opts->segmentSize <= INT_MAX;
+	} else if (strcmp(key, "noise_samples") == 0) {
+		ok = parseInt(vals[0], &opts->noiseSamples) && opts->noiseSamples > 0;
+		opts->noise = 1;
+	} else if (strcmp(key, "noise_quantum") == 0) {
+		ok = parseDouble(vals[0], &opts->noiseQuantum) && opts->noiseQuantum > 0;
+		opts->noise = 1;
+	} else if (strcmp(key, "warmup_loops") == 0) {
+		ok = parseInt(vals[0], &opts->warmupLoops);
+	} else if (strcmp(key, "min_loops") == 0) {
+		ok = parseInt(vals[0], &opts->minLoops);
+	} else if (strcmp(key, "max_loops") == 0) {
+		ok = parseInt(vals[0], &opts->maxLoops);
+	} else if (strcmp(key, "precision") == 0) {
+		ok = parseDouble(vals[0], &opts->precision);
+	} else if (strcmp(key, "pause") == 0) {
+		ok = parseInt(vals[0], &opts->pause);
+	} else if (strcmp(key, "threshold") == 0) {
+		ok = parseDouble(vals[0], &opts->threshold);
+	} else if (strcmp(key, "tune_output") == 0) {
+		strncpy(opts->tune, vals[0], MAX_PATH_LEN - 1);
+		opts->sweep = 1;
+	} else if (strcmp(key, "decisions") == 0) {
+		strncpy(opts->decisions, vals[0], MAX_PATH_LEN - 1);
+	} else if (strcmp(key, "output") == 0) {
+		strncpy(opts->output, vals[0], MAX_PATH_LEN - 1);
+	} else if (strcmp(key, "baseline") == 0) {
+		strncpy(opts->baseline, vals[0], MAX_PATH_LEN - 1);
+	} else if (strcmp(key, "format") == 0) {
+		if (strcmp(vals[0], "text") == 0) {
+			opts->format = FormatText;
+		} else if (strcmp(vals[0], "csv") == 0) {
+			opts->format = FormatCsv;
+		} else if (strcmp(vals[0], "json") == 0) {
+			opts->format = FormatJson;
+		} else {
+			ok = 0;
+		}
+	} else {
+		ok = 0;
+	}
+
+	return ok ? OK : ErrInvalidArgs;
+}
+
+#define MAX_LINE_LEN 4096
+#define MAX_VALS     MAX_OPS
+
+static Error
+readConfig(const char *path, Options *opts)
+{
+	Error error = OK;
+	char line[MAX_LINE_LEN];
+
+	FILE *config = fopen(path, "r");
+	if (!config) {
+		return ErrFile;
+	}
+
+	while (error == OK && fgets(line, MAX_LINE_LEN, config)) {
+		char *comment = strchr(line, '#');
+		if (comment) {
+			*comment = '\0';
+		}
+
+		char *key = strtok(line, " \t\r\n");
+		if (!key) {
+			continue;
+		}
+
+		char *vals[MAX_VALS];
+		int nVals = 0;
+		for (char *val = strtok(NULL, " \t\r\n"); val; val = strtok(NULL, " \t\r\n")) {
+			if (nVals == MAX_VALS) {
+				error = ErrInvalidArgs;
+				break;
+			}
+			vals[nVals++] = val;
+		}
+
+		if (error == OK) {
+			error = setOption(opts, key, vals, nVals);
+		}
+	}
+
+	fclose(config);
+	return error;
+}
+
+/* long options map to the config keys, e.g. --max-size to max_size */
+Error
+parseOptions(int argc, char *argv[], Options *opts, const char **defaultOps, int nDefaultOps)
+{
+	Error error = OK;
+
+	memset(opts, 0, sizeof(*opts));
+	opts->minSize = DEFAULT_MIN_SIZE;
+	opts->maxSize = DEFAULT_MAX_SIZE;
+	opts->format = FormatText;
+	opts->warmupLoops = opts->minLoops = opts->maxLoops = -1;
+	opts->precision = -1;
+	opts->threshold = DEFAULT_THRESHOLD;
+	opts->interferenceThreads = DEFAULT_INTERFERENCE_THREADS;
+	opts->interferenceSize = DEFAULT_INTERFERENCE_SIZE;
+	opts->noiseSamples = DEFAULT_NOISE_SAMPLES;
+	opts->noiseQuantum = DEFAULT_NOISE_QUANTUM;
+
+	for (int i = 1; i < argc && error == OK; i++) {
+		const char *arg = argv[i];
+		char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strncmp(arg, "--", 2) != 0) {
+			error = ErrInvalidArgs;
+		} else if (strcmp(arg, "--sweep") == 0) {
+			opts->sweep = 1;
+		} else if (strcmp(arg, "--overlap") == 0) {
+			opts->overlap = 1;
+		} else if (strcmp(arg, "--split") == 0) {
+			opts->split = 1;
+		} else if (strcmp(arg, "--noise") == 0) {
+			opts->noise = 1;
+		} else if (strcmp(arg, "--progress-thread") == 0) {
+			opts->progressThread = 1;
+		} else if (strcmp(arg, "--check") == 0) {
+			opts->check = 1;
+		} else if (!val) {
+			error = ErrInvalidArgs;
+		} else if (strcmp(arg, "--config") == 0) {
+			error = readConfig(val, opts);
+			i++;
+		} else {
+			char key[MAX_NAME_LEN] = "";
+			strncpy(key, arg + 2, MAX_NAME_LEN - 1);
+			for (char *c = key; *c; c++) {
+				*c = *c == '-' ? '_' : *c;
+			}
+
+			/* lists such as --ops and --sizes are comma-separated */
+			char *vals[MAX_VALS];
+			int nVals = 0;
+			for (char *v = strtok(val, ","); v && nVals < MAX_VALS; v = strtok(NULL, ",")) {
+				vals[nVals++] = v;
+			}
+
+			error = setOption(opts, key, vals, nVals);
+			i++;
+		}
+	}
+
+	if (opts->overlap && opts->nOps == 0) {
+		for (int b = 0; b < nBenchmarks; b++) {
+			if (benchmarks[b].nonblocking) {
+				addOp(opts, benchmarks[b].name);
+			}
+		}
+	}
+	if (strlen(opts->tune) > 0 && opts->nOps == 0) {
+		for (int b = 0; b < nBenchmarks; b++) {
+			if (isTunedVariant(benchmarks[b].name)) {
+				addOp(opts, benchmarks[b].name);
+			}
+		}
+	}
+	if (opts->nOps == 0) {
+		for (int op = 0; op < nDefaultOps; op++) {
+			addOp(opts, defaultOps[op]);
+		}
+	}
+
+	if (opts->nSizes == 0) {
+		if (opts->minSize > opts->maxSize) {
+			error = ErrInvalidArgs;
+		}
+		if (!opts->sweep) {
+			opts->minSize = opts->maxSize = 1;
+		}
+		for (long size = opts->minSize; size <= opts->maxSize && opts->nSizes < MAX_SIZES; size *= 2) {
+			opts->sizes[opts->nSizes++] = size;
+		}
+	}
+	for (int s = 0; s < opts->nSizes; s++) {
+		if (opts->sizes[s] > INT_MAX) {
+			error = ErrInvalidArgs;
+		}
+	}
+
+	return error;
+}
+
+int
+threadLevel(const Options *opts)
+{
+	/* the background threads of --interference don't call MPI */
+	if ((opts->concurrent && opts->concurrency == ConcurrencyThreads) || opts->progressThread) {
+		return MPI_THREAD_MULTIPLE;
+	}
+	return MPI_THREAD_FUNNELED;
+}
+
+void
+freeResults(Result *results, int n)
+{
+	for (int r = 0; r < n && results; r++) {
+		free(results[r].ranks);
+	}
+	free(results);
+}
+
+void
+printHeader(FILE *out, Format format)
+{
+	switch (format) {
+		case FormatCsv:
+			fprintf(out, "name,scope,comm_size,bytes,loops,samples,outliers,"
+			             "min,median,p90,p99,max,mean,stddev,ci,bandwidth,rate,"
+			             "min_completion,max_completion,max_skew,slowest_rank,overlap,slowdown,op_latency\n");
+			break;
+		case FormatJson:
+			fprintf(out, "[\n");
+			break;
+		default:
+			break;
+	}
+}
+
+void
+printFooter(FILE *out, Format format)
+{
+	if (format == FormatJson) {
+		fprintf(out, "]\n");
+	}
+	fflush(out);
+}
+
+#define MAX_FMT_LEN 256
+
+void
+printResult(FILE *out, Format format, const Result *result, const char *timeSpec, int first)
+{
+	const Stats *s = &result->stats;
+
+	switch (format) {
+		case FormatCsv:
+			fprintf(out, "%s,%s,%d,%d,%d,%d,%d,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.0f,%.0f,"
+			             "%.9f,%.9f,%.9f,%d,",
+			        result->name, result->scope, result->commSize, result->bytes, result->loops, s->n,
+			        s->outliers, s->min, s->median, s->p90, s->p99, s->max, s->mean, s->stddev,
+			        s->ci, result->bandwidth, result->rate, result->minCompletion, result->maxCompletion,
+			        result->maxSkew, result->slowest);
+			if (result->overlap >= 0) {
+				fprintf(out, "%.1f", result->overlap);
+			}
+			fprintf(out, ",");
+			if (result->slowdown > 0) {
+				fprintf(out, "%.3f", result->slowdown);
+			}
+			fprintf(out, ",");
+			if (result->opLatency > 0) {
+				fprintf(out, "%.9f", result->opLatency);
+			}
+			fprintf(out, "\n");
+			break;
+
+		case FormatJson:
+			fprintf(out, "%s{\"name\": \"%s\", \"scope\": \"%s\", \"comm_size\": %d, \"bytes\": %d, \"loops\": %d, "
+			             "\"samples\": %d, \"outliers\": %d, \"min\": %.9f, \"median\": %.9f, "
+			             "\"p90\": %.9f, \"p99\": %.9f, \"max\": %.9f, \"mean\": %.9f, "
+			             "\"stddev\": %.9f, \"ci\": %.9f, \"bandwidth\": %.0f, \"rate\": %.0f, "
+			             "\"min_completion\": %.9f, \"max_completion\": %.9f, \"max_skew\": %.9f, "
+			             "\"slowest_rank\": %d, ",
+			        first ? "  " : ", ", result->name, result->scope, result->commSize, result->bytes,
+			        result->loops, s->n, s->outliers, s->min, s->median, s->p90, s->p99, s->max,
+			        s->mean, s->stddev, s->ci, result->bandwidth, result->rate, result->minCompletion,
+			        result->maxCompletion, result->maxSkew, result->slowest);
+			if (result->overlap >= 0) {
+				fprintf(out, "\"overlap\": %.1f, ", result->overlap);
+			}
+			if (result->slowdown > 0) {
+				fprintf(out, "\"slowdown\": %.3f, ", result->slowdown);
+			}
+			if (result->opLatency > 0) {
+				fprintf(out, "\"op_latency\": %.9f, ", result->opLatency);
+			}
+			fprintf(out, "\"ranks\": [");
+			for (int r = 0; r < result->commSize && result->ranks; r++) {
+				fprintf(out, "%s{\"completion\": %.9f, \"skew\": %.9f, \"slowest\": %d}",
+				        r ? ", " : "", result->ranks[r].completion, result->ranks[r].skew,
+				        result->ranks[r].slowest);
+			}
+			fprintf(out, "]}\n");
+			break;
+
+		default: {
+			char fmt[MAX_FMT_LEN] = "";
+			const char *t = timeSpec;
+			if (strcmp(result->scope, "world") != 0) {
+				fprintf(out, "%s on %d %s ranks", result->name, result->commSize, result->scope);
+			} else {
+				fprintf(out, "%s", result->name);
+			}
+			snprintf(fmt, MAX_FMT_LEN,
+			         " (%%d bytes):\tmedian %s, p90 %s, p99 %s, min %s, mean %s +- %s "
+			         "(stddev %s) seconds, %%.2f MB/s, took %%d loops (%%d outliers)\n",
+			         t, t, t, t, t, t, t);
+			fprintf(out, fmt, result->bytes, s->median, s->p90, s->p99, s->min,
+			        s->mean, s->ci, s->stddev, result->bandwidth / 1e6, result->loops, s->outliers);
+
+			snprintf(fmt, MAX_FMT_LEN,
+			         "\tcompletion %s..%s seconds, slowest rank %%d (%%d of %%d loops), skew",
+			         t, t);
+			fprintf(out, fmt, result->minCompletion, result->maxCompletion, result->slowest,
+			        result->ranks[result->slowest].slowest, s->n);
+			snprintf(fmt, MAX_FMT_LEN, " %s", t);
+			for (int r = 0; r < result->commSize; r++) {
+				fprintf(out, fmt, result->ranks[r].skew);
+			}
+			fprintf(out, "\n");
+			if (result->opLatency > 0) {
+				snprintf(fmt, MAX_FMT_LEN, "\t%%.0f ops/s, %s seconds per op\n", t);
+				fprintf(out, fmt, result->rate, result->opLatency);
+			} else if (result->rate > 0) {
+				fprintf(out, "\t%.0f messages/s\n", result->rate);
+			}
+			if (result->overlap >= 0) {
+				fprintf(out, "\toverlap %.1f%%\n", result->overlap);
+			}
+			if (result->slowdown > 0) {
+				fprintf(out, "\tslowdown %.2fx against the quiet run\n", result->slowdown);
+			}
+			break;
+		}
+	}
+	fflush(out);
+}
+
+/* keeps the series of test as a result, on TESTER_HELPER_RANK only */
+static int
+collect(Result *result, const char *name, const Bench *bench, const Tester *test)
+{
+	memset(result, 0, sizeof(*result));
+	strncpy(result->name, name, MAX_NAME_LEN - 1);
+	strncpy(result->scope, bench->scope, MAX_SCOPE_LEN - 1);
+	result->commSize = bench->size;
+	result->bytes = bench->count;
+	result->loops = test->loops;
+	result->stats = test->stats;
+	if (test->stats.median > 0) {
+		int messages = bench->messages ? bench->messages : 1;
+		result->bandwidth = (double)messages * bench->count / test->stats.median;
+		result->rate = bench->messages / test->stats.median;
+	}
+	result->overlap = -1;
+
+	result->ranks = (RankStats *)malloc(test->size * sizeof(RankStats));
+	if (!result->ranks) {
+		return 0;
+	}
+	memcpy(result->ranks, test->ranks, test->size * sizeof(RankStats));
+
+	/* means over the loops of the per-rank completion times and entry skews */
+	result->minCompletion = INFINITY;
+	result->slowest = slowestRank(test);
+	for (int r = 0; r < test->size; r++) {
+		const RankStats *rank = &test->ranks[r];
+		if (rank->completion < result->minCompletion) {
+			result->minCompletion = rank->completion;
+		}
+		if (rank->completion > result->maxCompletion) {
+			result->maxCompletion = rank->completion;
+		}
+		if (rank->skew > result->maxSkew) {
+			result->maxSkew = rank->skew;
+		}
+	}
+
+	return 1;
+}
+
+static void
+configure(Tester *test, const Options *opts)
+{
+	if (opts->warmupLoops >= 0) {
+		test->warmupLoops = opts->warmupLoops;
+	}
+	if (opts->minLoops >= 0) {
+		test->minLoops = opts->minLoops;
+	}
+	if (opts->maxLoops >= 0) {
+		test->maxLoops = opts->maxLoops;
+	}
+	if (opts->precision >= 0) {
+		test->precision = opts->precision;
+	}
+	test->pause = opts->pause;
+}
+
+static void
+measure(Tester *test, BenchFunc run, const char *name, Bench *bench)
+{
+	char series[MAX_NAME_LEN] = "";
+	snprintf(series, MAX_NAME_LEN, "%s %d", name, bench->count);
+	bench->messages = 0;
+
+	int stop = 0;
+	do {
+		start(test, series);
+		run(bench);
+		stop = finish(test);
+	} while (!stop);
+}
+
+/* what a series derives from the ones before it, see Result */
+typedef struct {
+	double overlap, slowdown, opLatency;
+} Derived;
+
+static const Derived notDerived = {-1, 0, 0};
+
+/* collects and prints the last series on TESTER_HELPER_RANK, unless results is NULL */
+static Error
+keep(const Options *opts, const char *name, const Bench *bench, const Tester *test,
+     const Derived *derived, Result *results, int *nResults)
+{
+	Error error = OK;
+
+	if (bench->rank == TESTER_HELPER_RANK && results) {
+		Result *result = &results[(*nResults)++];
+		if (!collect(result, name, bench, test)) {
+			error = ErrOutOfMemory;
+		} else {
+			result->overlap = derived->overlap;
+			result->slowdown = derived->slowdown;
+			result->opLatency = derived->opLatency;
+			printResult(stdout, opts->format, result, test->timeSpec, *nResults == 1);
+		}
+	}
+	MPI_Bcast(&error, 1, MPI_INT, TESTER_HELPER_RANK, bench->comm);
+
+	return error;
+}
+
+static int
+computeOnly(Bench *bench)
+{
+	compute(bench->compute);
+	return MPI_SUCCESS;
+}
+
+/*
+ * Runs the kernel alone and between post and wait, calibrated to the
+ * median of the pure communication series on TESTER_HELPER_RANK:
+ * overlap = 1 - (t_overall - t_compute) / t_communication, as in the
+ * OSU non-blocking benchmarks.
+ */
+static Error
+measureOverlap(const Options *opts, const Benchmark *benchmark, double communication, Bench *bench,
+               Tester *test, Result *results, int *nResults)
+{
+	double computation = 0;
+	Derived derived = notDerived;
+	MPI_Bcast(&communication, 1, MPI_DOUBLE, TESTER_HELPER_RANK, bench->comm);
+
+	bench->compute = communication;
+
+	measure(test, computeOnly, "compute", bench);
+	computation = test->stats.median;
+
+	char name[MAX_NAME_LEN] = "";
+	snprintf(name, MAX_NAME_LEN, "%s+compute", benchmark->name);
+	measure(test, benchmark->run, name, bench);
+
+	derived.overlap = 0;
+	if (communication > 0) {
+		double overlap = 100 * (1 - (test->stats.median - computation) / communication);
+		derived.overlap = overlap < 0 ? 0 : overlap > 100 ? 100 : overlap;
+	}
+
+	bench->compute = 0;
+
+	return keep(opts, name, bench, test, &derived, results, nResults);
+}
+
+/* runs the series again under load, quiet is its median on TESTER_HELPER_RANK */
+static Error
+measureInterference(const Options *opts, const Benchmark *benchmark, double quiet, Bench *bench,
+                    Tester *test, Result *results, int *nResults)
+{
+	Error error = OK;
+
+	Interference *load = startInterference(opts->interference, opts->interferenceThreads,
+	                                       opts->interferenceSize);
+	if (!load) {
+		error = ErrOutOfMemory;
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, bench->comm);
+	if (error != OK) {
+		stopInterference(load);
+		return error;
+	}
+
+	char name[MAX_NAME_LEN] = "";
+	snprintf(name, MAX_NAME_LEN, "%s+%s-load", benchmark->name, loadName(opts->interference));
+	measure(test, benchmark->run, name, bench);
+
+	stopInterference(load);
+
+	Derived derived = notDerived;
+	derived.slowdown = quiet > 0 ? test->stats.median / quiet : 0;
+	return keep(opts, name, bench, test, &derived, results, nResults);
+}
+
+/* runs the series with bench->concurrent instances, the per-op latency is the worst rank's */
+static Error
+measureConcurrent(const Options *opts, const Benchmark *benchmark, Bench *bench, Tester *test,
+                  Result *results, int *nResults)
+{
+	Derived derived = notDerived;
+
+	char name[MAX_NAME_LEN] = "";
+	snprintf(name, MAX_NAME_LEN, "%s*%d", benchmark->name, opts->concurrent);
+
+	selectConcurrent(bench->concurrent, benchmark);
+	measure(test, runConcurrent, name, bench);
+
+	double latency = concurrentLatency(bench->concurrent);
+	MPI_Reduce(&latency, &derived.opLatency, 1, MPI_DOUBLE, MPI_MAX, TESTER_HELPER_RANK, bench->comm);
+
+	return keep(opts, name, bench, test, &derived, results, nResults);
+}
+
+/*
+ * Least-squares fit of t = alpha + beta * bytes over the results of name,
+ * t being the time per message for point-to-point ops (one way for the
+ * ping-pong) and the median of the whole op for collectives.
+ */
+static void
+printFit(const Options *opts, const char *name, const Result *results, int n, const char *timeSpec)
+{
+	double sx = 0, sy = 0, sxx = 0, sxy = 0;
+	int points = 0;
+
+	for (int r = 0; r < n; r++) {
+		if (strcmp(results[r].name, name) == 0) {
+			double x = results[r].bytes;
+			double y = results[r].rate > 0 ? 1 / results[r].rate : results[r].stats.median;
+			sx += x, sy += y, sxx += x * x, sxy += x * y;
+			points++;
+		}
+	}
+
+	double d = points * sxx - sx * sx;
+	if (points < 2 || d == 0) {
+		return;
+	}
+	double beta = (points * sxy - sx * sy) / d;
+	double alpha = (sy - beta * sx) / points;
+
+	char fmt[MAX_FMT_LEN] = "";
+	snprintf(fmt, MAX_FMT_LEN, "%%s fit over %%d sizes:\talpha %s seconds, beta %%.3e seconds/byte",
+	         timeSpec);
+	FILE *out = opts->format == FormatText ? stdout : stderr;
+	fprintf(out, fmt, name, points, alpha, beta);
+	if (beta > 0) {
+		fprintf(out, " (%.2f MB/s)", 1 / beta / 1e6);
+	}
+	fprintf(out, "\n");
+	fflush(out);
+}
+
+/* runs all the series on bench->comm, appending the results on its TESTER_HELPER_RANK if any */
+static Error
+runSeries(const Options *opts, Bench *bench, Result *results, int *nResults)
+{
+	Error error = OK;
+
+	Tester *test = init(bench->comm);
+	if (!test) {
+		return ErrOutOfMemory;
+	}
+	configure(test, opts);
+
+	if (opts->overlap) {
+		calibrate();
+	}
+	if (opts->concurrent) {
+		bench->concurrent = startConcurrent(bench, opts->concurrent, opts->concurrency);
+		if (!bench->concurrent) {
+			release(test);
+			return ErrOutOfMemory;
+		}
+	}
+
+	for (int op = 0; op < opts->nOps && error == OK; op++) {
+		const Benchmark *benchmark = findBenchmark(opts->ops[op]);
+		int first = *nResults;
+
+		for (int s = 0; s < opts->nSizes && error == OK; s++) {
+			bench->count = opts->sizes[s];
+
+			measure(test, benchmark->run, benchmark->name, bench);
+			error = keep(opts, benchmark->name, bench, test, &notDerived, results, nResults);
+			double median = test->stats.median;
+
+			if (error == OK && opts->interference != LoadNone) {
+				error = measureInterference(opts, benchmark, median, bench, test, results, nResults);
+			}
+			if (error == OK && opts->overlap && benchmark->nonblocking) {
+				error = measureOverlap(opts, benchmark, median, bench, test, results, nResults);
+			}
+			if (error == OK && bench->concurrent && canRunConcurrent(bench->concurrent, benchmark)) {
+				error = measureConcurrent(opts, benchmark, bench, test, results, nResults);
+			}
+		}
+
+		if (error == OK && bench->rank == TESTER_HELPER_RANK && results) {
+			printFit(opts, benchmark->name, &results[first], *nResults - first, test->timeSpec);
+		}
+	}
+
+	stopConcurrent(bench->concurrent);
+	bench->concurrent = NULL;
+
+	release(test);
+	return error;
+}
+
+/*
+ * Runs the series on the node and leaders comms of bench->comm, then on
+ * bench->comm itself. Rank 0 of bench->comm is on node 0 and leads it,
+ * so it keeps the results of every scope.
+ */
+static Error
+runScopes(const Options *opts, Bench *bench, Result *results, int *nResults)
+{
+	Error error = OK;
+	Topology topo;
+
+	if (splitTopology(bench->comm, opts->ranksPerNode, &topo) != MPI_SUCCESS) {
+		return ErrMpi;
+	}
+
+	const struct {
+		const char *name;
+		MPI_Comm comm;
+		int keep;
+	} scopes[] = {
+		{"node",    topo.nodeComm,   topo.node == 0},
+		{"leaders", topo.leaderComm, 1},
+		{"world",   bench->comm,     1},
+	};
+
+	MPI_Comm comm = bench->comm;
+	for (int s = 0; s < sizeof(scopes) / sizeof(*scopes) && error == OK; s++) {
+		if (scopes[s].comm != MPI_COMM_NULL) {
+			bench->comm = scopes[s].comm;
+			bench->scope = scopes[s].name;
+			MPI_Comm_rank(bench->comm, &bench->rank);
+			MPI_Comm_size(bench->comm, &bench->size);
+
+			error = runSeries(opts, bench, scopes[s].keep ? results : NULL, nResults);
+		}
+		bench->comm = comm;
+		MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, bench->comm);
+	}
+
+	freeTopology(&topo);
+	return error;
+}
+
+/*
+ * Per-rank noise, then for every result on the whole comm (or its first
+ * ranks) how it correlates across the ranks with the loops each rank
+ * finished last and with its mean completion time.
+ */
+static void
+printNoise(const Options *opts, const Noise *noise, int size, const Result *results, int nResults)
+{
+	FILE *out = opts->format == FormatText ? stdout : stderr;
+
+	for (int r = 0; r < size; r++) {
+		const Noise *n = &noise[r];
+		fprintf(out, "rank %d noise:\tFWQ quantum %.9f seconds, %.2f%% lost, %d detours, worst",
+		        r, n->quantum, n->lost * 100, n->detours);
+		for (int d = 0; d < MAX_DETOURS; d++) {
+			fprintf(out, " %.9f", n->worst[d]);
+		}
+		fprintf(out, "; FTQ %.2f%% lost, peaks", n->ftqLost * 100);
+		for (int p = 0; p < MAX_PEAKS; p++) {
+			fprintf(out, " %.1f", n->peaks[p]);
+		}
+		fprintf(out, " Hz\n");
+	}
+
+	double *lost = (double *)malloc(3 * size * sizeof(double));
+	if (!lost) {
+		return;
+	}
+	double *slowest = lost + size, *completion = lost + 2 * size;
+
+	for (int r = 0; r < nResults; r++) {
+		const Result *result = &results[r];
+		if (strcmp(result->scope, "world") != 0 || result->commSize < 3) {
+			continue;
+		}
+
+		for (int k = 0; k < result->commSize; k++) {
+			lost[k] = noise[k].lost;
+			slowest[k] = result->ranks[k].slowest;
+			completion[k] = result->ranks[k].completion;
+		}
+		fprintf(out, "%s (%d ranks, %d bytes):\tp99 %.2f times the median, noise vs slowest r = %.2f, "
+		             "vs completion r = %.2f\n",
+		        result->name, result->commSize, result->bytes,
+		        result->stats.median > 0 ? result->stats.p99 / result->stats.median : 0,
+		        correlation(lost, slowest, result->commSize),
+		        correlation(lost, completion, result->commSize));
+	}
+	fflush(out);
+
+	free(lost);
+}
+
+static Error
+checkBaseline(const Options *opts, const Result *results, int nResults)
+{
+	Result *base = NULL;
+	int nBase = 0;
+
+	Error error = loadResults(opts->baseline, &base, &nBase);
+	if (error != OK) {
+		return error;
+	}
+
+	FILE *out = opts->format == FormatText ? stdout : stderr;
+	int regressions = compareResults(base, nBase, results, nResults, opts->threshold, out);
+	freeResults(base, nBase);
+
+	return regressions ? ErrRegression : OK;
+}
+
+Error
+runBenchmarks(const Options *opts, MPI_Comm comm)
+{
+	Error error = OK;
+	Bench bench = {};
+	Result *results = NULL;
+	int nResults = 0;
+	Noise *noise = NULL;
+
+	int rank = 0, size = 0;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+
+	int commSizes[MAX_COMM_SIZES] = {size};
+	int nCommSizes = opts->nCommSizes ? opts->nCommSizes : 1;
+	memcpy(commSizes, opts->commSizes, opts->nCommSizes * sizeof(int));
+
+	if (opts->segmentSize > 0) {
+		bcastSegment = opts->segmentSize;
+	}
+	hierarchyRanksPerNode = opts->ranksPerNode;
+
+	long maxSize = 0;
+	for (int s = 0; s < opts->nSizes; s++) {
+		maxSize = opts->sizes[s] > maxSize ? opts->sizes[s] : maxSize;
+	}
+
+	/*
+	 * Only the root holds the whole comm's data in gather and scatter, every
+	 * rank in allgather and alltoall. The split scopes have a root per node,
+	 * so any rank may be one, and the leaders' comm is no larger than size.
+	 */
+	int wholeComm = rank == bench.root || opts->split;
+	for (int op = 0; op < opts->nOps; op++) {
+		wholeComm |= findBenchmark(opts->ops[op])->allRanks;
+	}
+	bench.bytes = maxSize * (wholeComm ? size : 1);
+	bench.sbuf = (char *)calloc(bench.bytes, sizeof(char));
+	bench.rbuf = (char *)calloc(bench.bytes, sizeof(char));
+	if (!bench.sbuf || !bench.rbuf) {
+		error = ErrOutOfMemory;
+	}
+	if (rank == TESTER_HELPER_RANK) {
+		/* a result per series: quiet, loaded, overlapped and concurrent, on up to three scopes */
+		int nSeries = 1 + (opts->interference != LoadNone) + opts->overlap + (opts->concurrent > 0);
+		int nScopes = opts->split ? 3 : 1;
+		results = (Result *)calloc(nSeries * nScopes * nCommSizes * opts->nOps * opts->nSizes,
+		                           sizeof(Result));
+		noise = (Noise *)calloc(size, sizeof(Noise));
+		if (!results || !noise) {
+			error = ErrOutOfMemory;
+		}
+	}
+	for (int c = 0; c < nCommSizes; c++) {
+		if (commSizes[c] < 1 || commSizes[c] > size) {
+			error = ErrInvalidArgs;
+		}
+	}
+	int provided = 0;
+	MPI_Query_thread(&provided);
+	if (provided < threadLevel(opts)) {
+		error = ErrThreadLevel;
+	}
+	if (error == OK && opts->progressThread && startProgress() != MPI_SUCCESS) {
+		error = ErrThreadLevel;
+	}
+	if (strlen(opts->decisions) > 0 && loadDecisions(opts->decisions, comm) != MPI_SUCCESS) {
+		error = ErrFile;
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, comm);
+	if (error != OK) {
+		goto OUT;
+	}
+
+	if (opts->check) {
+		for (int c = 0; c < nCommSizes && error == OK; c++) {
+			MPI_Comm_split(comm, rank < commSizes[c] ? 0 : MPI_UNDEFINED, rank, &bench.comm);
+			if (bench.comm != MPI_COMM_NULL) {
+				error = checkCollectives(bench.comm, opts->sizes, opts->nSizes);
+				MPI_Comm_free(&bench.comm);
+			}
+			MPI_Bcast(&error, 1, MPI_INT, 0, comm);
+		}
+		goto OUT;
+	}
+
+	/* all the ranks at once, as they run the collectives */
+	if (opts->noise) {
+		Noise mine;
+		if (!measureNoise(opts->noiseSamples, opts->noiseQuantum, &mine)) {
+			error = ErrOutOfMemory;
+		}
+		MPI_Gather(&mine, sizeof(Noise), MPI_BYTE, noise, sizeof(Noise), MPI_BYTE,
+		           TESTER_HELPER_RANK, comm);
+		MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, comm);
+		if (error != OK) {
+			goto OUT;
+		}
+	}
+
+	if (rank == TESTER_HELPER_RANK) {
+		printHeader(stdout, opts->format);
+	}
+
+	for (int c = 0; c < nCommSizes && error == OK; c++) {
+		/* ranks keep their order, so TESTER_HELPER_RANK stays the same process */
+		MPI_Comm_split(comm, rank < commSizes[c] ? 0 : MPI_UNDEFINED, rank, &bench.comm);
+		if (bench.comm != MPI_COMM_NULL) {
+			MPI_Comm_rank(bench.comm, &bench.rank);
+			MPI_Comm_size(bench.comm, &bench.size);
+			bench.scope = "world";
+
+			if (opts->split) {
+				error = runScopes(opts, &bench, results, &nResults);
+			} else {
+				error = runSeries(opts, &bench, results, &nResults);
+			}
+
+			MPI_Comm_free(&bench.comm);
+		}
+		MPI_Bcast(&error, 1, MPI_INT, TESTER_HELPER_RANK, comm);
+	}
+
+	if (rank == TESTER_HELPER_RANK) {
+		printFooter(stdout, opts->format);
+
+		if (error == OK && opts->noise) {
+			printNoise(opts, noise, size, results, nResults);
+		}
+
+		if (error == OK && strlen(opts->output) > 0) {
+			error = writeResults(opts->output, results, nResults);
+		}
+		if (error == OK && strlen(opts->tune) > 0) {
+			error = writeDecisions(opts->tune, results, nResults);
+		}
+		if (error == OK && strlen(opts->baseline) > 0) {
+			error = checkBaseline(opts, results, nResults);
+		}
+	}
+	MPI_Bcast(&error, 1, MPI_INT, TESTER_HELPER_RANK, comm);
+
+OUT:
+	stopProgress();
+	free(bench.sbuf);
+	free(bench.rbuf);
+	freeResults(results, nResults);
+	free(noise);
+
+	return error;
+}
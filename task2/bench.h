@@ -0,0 +1,201 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "tester.h"
+#include "interference.h"
+#include "schedule.h"
+#include <stdio.h>
+#include <mpi.h>
+
+typedef enum {
+	OK = 0,
+	ErrOutOfMemory = 100,
+	ErrInvalidArgs = 101,
+	ErrRegression  = 102,
+	ErrFile        = 103,
+	ErrMpi         = 104,
+	ErrThreadLevel = 105,
+	ErrMismatch    = 106,
+} Error;
+
+const char *
+message(Error error);
+
+typedef enum {
+	FormatText = 0,
+	FormatCsv,
+	FormatJson,
+} Format;
+
+#define MAX_OPS        64
+#define MAX_SIZES      64
+#define MAX_COMM_SIZES 16
+#define MAX_PATH_LEN   256
+#define MAX_SCOPE_LEN  16
+
+typedef struct {
+	char ops[MAX_OPS][MAX_NAME_LEN];
+	int nOps;
+
+	int sweep;
+	int overlap;
+	long minSize, maxSize;
+	long sizes[MAX_SIZES];
+	int nSizes;
+
+	/* sub-communicators of the first N ranks, the whole comm if empty */
+	int commSizes[MAX_COMM_SIZES];
+	int nCommSizes;
+
+	/* also run on the node and leaders comms, see topology.h */
+	int split;
+	int ranksPerNode;   /* emulated nodes if positive */
+
+	/* each series again with background threads on every rank, see interference.h */
+	Load interference;
+	int interferenceThreads;
+	long interferenceSize;
+
+	/* each series again with concurrent instances, see concurrent.h */
+	int concurrent;
+	int concurrency;    /* a Concurrency */
+
+	/* of the pipelined bcast, the default of collectives.h if 0 */
+	long segmentSize;
+
+	/* progress the custom non-blocking ops from a thread, see schedule.h */
+	int progressThread;
+
+	/* compare the custom collectives' results against MPI's instead of timing, see check.h */
+	int check;
+
+	/* decision tables of the custom collectives written and read, see tuner.h */
+	char tune[MAX_PATH_LEN];
+	char decisions[MAX_PATH_LEN];
+
+	/* FWQ and FTQ on every rank before the series, see noise.h */
+	int noise;
+	int noiseSamples;
+	double noiseQuantum;
+
+	/* Tester settings */
+	int warmupLoops, minLoops, maxLoops;
+	double precision;
+	int pause;
+
+	Format format;
+	char output[MAX_PATH_LEN];
+	char baseline[MAX_PATH_LEN];
+	double threshold;
+} Options;
+
+/*
+ * Parses argv (and the --config file) on every rank, before MPI_Init so
+ * the thread level can depend on the options. Operations not given fall
+ * back to the defaults.
+ */
+Error
+parseOptions(int argc, char *argv[], Options *opts, const char **defaultOps, int nDefaultOps);
+
+void
+usage(const char *prog);
+
+/* the MPI_Init_thread level the options need */
+int
+threadLevel(const Options *opts);
+
+typedef struct Concurrent Concurrent;
+
+/* state a benchmark body runs against, buffers are sized for the largest message */
+typedef struct {
+	MPI_Comm comm;
+	int rank, size;
+	int root;
+	int count;       /* bytes per rank of the current point */
+	char *sbuf, *rbuf;
+	size_t bytes;    /* of each buffer */
+	double compute;  /* seconds of computation between post and wait, non-blocking ops only */
+	const char *scope;  /* "world", "node" or "leaders" */
+	int messages;       /* messages or concurrent ops of count bytes a body moved, 0 for a collective */
+	Concurrent *concurrent;
+} Bench;
+
+typedef int (*BenchFunc)(Bench *bench);
+
+/* starts a non-blocking op, which run then waits for */
+typedef int (*PostFunc)(Bench *bench, MPI_Request *request);
+
+/* the same for the custom ones, whose request is a schedule */
+typedef int (*SchedulePostFunc)(Bench *bench, Schedule **request);
+
+typedef struct {
+	const char *name;
+	BenchFunc run;
+	PostFunc post;   /* non-blocking ops only */
+	int allRanks;    /* every rank moves count bytes from or to each, as in allgather and alltoall */
+	int nonblocking; /* the body computes for bench->compute between post and wait */
+	SchedulePostFunc postSchedule;  /* custom non-blocking ops only */
+} Benchmark;
+
+/* every benchmark the harness knows, see benchmarks.c */
+extern const Benchmark benchmarks[];
+extern const int nBenchmarks;
+
+const Benchmark *
+findBenchmark(const char *name);
+
+/*
+ * One reported point, bandwidth is in bytes per second: the message size
+ * over the median for collectives, all the bytes moved over the median
+ * for point-to-point ops.
+ */
+typedef struct {
+	char name[MAX_NAME_LEN];
+	char scope[MAX_SCOPE_LEN];
+	int commSize, bytes, loops;
+	Stats stats;
+	double bandwidth;
+	double rate;     /* messages or ops per second, point-to-point and concurrent ops only */
+	double minCompletion, maxCompletion, maxSkew;
+	int slowest;
+	RankStats *ranks;
+	double overlap;  /* percent of the communication hidden by computation, < 0 if not measured */
+	double slowdown; /* median over the one of the quiet run, 0 if not measured */
+	double opLatency;  /* mean time of each of the concurrent ops, 0 if not measured */
+} Result;
+
+void
+freeResults(Result *results, int n);
+
+void
+printHeader(FILE *out, Format format);
+
+/* the first result of a JSON array is printed without the separator */
+void
+printResult(FILE *out, Format format, const Result *result, const char *timeSpec, int first);
+
+void
+printFooter(FILE *out, Format format);
+
+/*
+ * Runs every operation for each message size and comm size of the run
+ * and reports the latency statistics and the effective bandwidth, i.e.
+ * the per-rank message size over the median. Results are written to
+ * opts->output as JSON and compared against opts->baseline if given.
+ * Ops measured on two sizes or more also get a least-squares fit of the
+ * time per message alpha + beta * bytes, i.e. the latency and the inverse
+ * bandwidth, or of the whole op for collectives.
+ * With opts->interference every series runs again under load and the
+ * slowdown against the quiet run is reported.
+ * With opts->concurrent every series runs again with that many instances
+ * in flight, for the aggregate throughput and the per-op latency.
+ * With opts->noise the OS noise of every rank is measured first and
+ * correlated with which ranks finished the collectives last.
+ * With opts->split every comm is also split into nodes and leaders:
+ * all the nodes run each series at once and the node of rank 0 is
+ * reported.
+ */
+Error
+runBenchmarks(const Options *opts, MPI_Comm comm);
+
+#endif
@@ -0,0 +1,648 @@
+#include "bench.h"
+#include "collectives.h"
+#include "kernel.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+static int
+mpiBcast(Bench *b)
+{
+	return MPI_Bcast(b->sbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+mpiGather(Bench *b)
+{
+	return MPI_Gather(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+mpiReduce(Bench *b)
+{
+	return MPI_Reduce(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->root, b->comm);
+}
+
+static int
+mpiScatter(Bench *b)
+{
+	return MPI_Scatter(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+mpiAllgather(Bench *b)
+{
+	return MPI_Allgather(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->comm);
+}
+
+static int
+mpiAllreduce(Bench *b)
+{
+	return MPI_Allreduce(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm);
+}
+
+static int
+mpiAlltoall(Bench *b)
+{
+	return MPI_Alltoall(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->comm);
+}
+
+static int
+mpiReduceScatterBlock(Bench *b)
+{
+	return MPI_Reduce_scatter_block(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm);
+}
+
+static int
+mpiScan(Bench *b)
+{
+	return MPI_Scan(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm);
+}
+
+static int
+mpiExscan(Bench *b)
+{
+	return MPI_Exscan(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm);
+}
+
+/* the v variants run with count bytes to and from every rank */
+#define UNIFORM_COUNTS(b)                         \
+	int counts[b->size], displs[b->size];         \
+	for (int r = 0; r < b->size; r++) {           \
+		counts[r] = b->count;                     \
+		displs[r] = r * b->count;                 \
+	}
+
+static int
+mpiAlltoallv(Bench *b)
+{
+	UNIFORM_COUNTS(b);
+	return MPI_Alltoallv(b->sbuf, counts, displs, MPI_CHAR, b->rbuf, counts, displs, MPI_CHAR, b->comm);
+}
+
+static int
+customBcast(Bench *b)
+{
+	return bcast(b->sbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customBcastLinear(Bench *b)
+{
+	return bcastLinear(b->sbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customBcastBinomial(Bench *b)
+{
+	return bcastBinomial(b->sbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customBcastPipeline(Bench *b)
+{
+	return bcastPipeline(b->sbuf, b->count, MPI_CHAR, b->root, b->comm, bcastSegment);
+}
+
+static int
+customBcastScatterAllgather(Bench *b)
+{
+	return bcastScatterAllgather(b->sbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customBcastShared(Bench *b)
+{
+	return bcastShared(b->sbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customBcastHierarchical(Bench *b)
+{
+	return bcastHierarchical(b->sbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customGather(Bench *b)
+{
+	return gather(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customGatherLinear(Bench *b)
+{
+	return gatherLinear(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customGatherBinomial(Bench *b)
+{
+	return gatherBinomial(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customGatherShared(Bench *b)
+{
+	return gatherShared(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customGatherHierarchical(Bench *b)
+{
+	return gatherHierarchical(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customReduce(Bench *b)
+{
+	return reduce(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->root, b->comm);
+}
+
+static int
+customReduceLinear(Bench *b)
+{
+	return reduceLinear(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->root, b->comm);
+}
+
+static int
+customReduceBinomial(Bench *b)
+{
+	return reduceBinomial(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->root, b->comm);
+}
+
+static int
+customReduceRabenseifner(Bench *b)
+{
+	return reduceRabenseifner(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->root, b->comm);
+}
+
+static int
+customReduceShared(Bench *b)
+{
+	return reduceShared(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->root, b->comm);
+}
+
+static int
+customReduceHierarchical(Bench *b)
+{
+	return reduceHierarchical(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->root, b->comm);
+}
+
+static int
+customScatter(Bench *b)
+{
+	return scatter(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customScatterLinear(Bench *b)
+{
+	return scatterLinear(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customScatterBinomial(Bench *b)
+{
+	return scatterBinomial(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customScatterShared(Bench *b)
+{
+	return scatterShared(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm);
+}
+
+static int
+customAllgather(Bench *b)
+{
+	return allgather(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->comm);
+}
+
+static int
+customAllgatherRing(Bench *b)
+{
+	return allgatherRing(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->comm);
+}
+
+static int
+customAllgatherRecursiveDoubling(Bench *b)
+{
+	return allgatherRecursiveDoubling(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->comm);
+}
+
+static int
+customAllgatherHierarchical(Bench *b)
+{
+	return allgatherHierarchical(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->comm);
+}
+
+static int
+customAllreduce(Bench *b)
+{
+	return allreduce(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm);
+}
+
+static int
+customAllreduceRing(Bench *b)
+{
+	return allreduceRing(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm);
+}
+
+static int
+customAllreduceRecursiveDoubling(Bench *b)
+{
+	return allreduceRecursiveDoubling(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm);
+}
+
+static int
+customAllreduceHierarchical(Bench *b)
+{
+	return allreduceHierarchical(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm);
+}
+
+static int
+customAlltoall(Bench *b)
+{
+	return alltoall(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->comm);
+}
+
+static int
+customAlltoallBruck(Bench *b)
+{
+	return alltoallBruck(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->comm);
+}
+
+static int
+customAlltoallPairwise(Bench *b)
+{
+	return alltoallPairwise(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->comm);
+}
+
+static int
+customAlltoallv(Bench *b)
+{
+	UNIFORM_COUNTS(b);
+	return alltoallv(b->sbuf, counts, displs, MPI_CHAR, b->rbuf, counts, displs, MPI_CHAR, b->comm);
+}
+#undef UNIFORM_COUNTS
+
+static int
+customReduceScatterBlock(Bench *b)
+{
+	return reduceScatterBlock(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm);
+}
+
+static int
+customScan(Bench *b)
+{
+	return scan(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm);
+}
+
+static int
+customExscan(Bench *b)
+{
+	return exscan(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm);
+}
+
+/* non-blocking ops spin for b->compute seconds between post and wait */
+static int
+overlapWait(Bench *b, MPI_Request *request)
+{
+	if (b->compute > 0) {
+		compute(b->compute);
+	}
+	return MPI_Wait(request, MPI_STATUS_IGNORE);
+}
+
+/* the post half of a non-blocking op and the body that waits for it */
+#define NONBLOCKING_IMPLEMENTATION(name, call)    \
+static int                                        \
+name##Post(Bench *b, MPI_Request *request)        \
+{                                                 \
+	return call;                                  \
+}                                                 \
+                                                  \
+static int                                        \
+name(Bench *b)                                    \
+{                                                 \
+	MPI_Request request;                          \
+	int ret = name##Post(b, &request);            \
+	if (ret != MPI_SUCCESS) {                     \
+		return ret;                               \
+	}                                             \
+	return overlapWait(b, &request);              \
+}
+
+NONBLOCKING_IMPLEMENTATION(mpiIbcast,
+	MPI_Ibcast(b->sbuf, b->count, MPI_CHAR, b->root, b->comm, request))
+NONBLOCKING_IMPLEMENTATION(mpiIgather,
+	MPI_Igather(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm, request))
+NONBLOCKING_IMPLEMENTATION(mpiIreduce,
+	MPI_Ireduce(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->root, b->comm, request))
+NONBLOCKING_IMPLEMENTATION(mpiIscatter,
+	MPI_Iscatter(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm, request))
+NONBLOCKING_IMPLEMENTATION(mpiIallreduce,
+	MPI_Iallreduce(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->comm, request))
+#undef NONBLOCKING_IMPLEMENTATION
+
+/* the custom non-blocking ops, completed by the wait or the progress thread */
+static int
+overlapWaitSchedule(Bench *b, Schedule **request)
+{
+	if (b->compute > 0) {
+		compute(b->compute);
+	}
+	return waitSchedule(request);
+}
+
+#define SCHEDULE_IMPLEMENTATION(name, call)       \
+static int                                        \
+name##Post(Bench *b, Schedule **request)          \
+{                                                 \
+	return call;                                  \
+}                                                 \
+                                                  \
+static int                                        \
+name(Bench *b)                                    \
+{                                                 \
+	Schedule *request = NULL;                     \
+	int ret = name##Post(b, &request);            \
+	if (ret != MPI_SUCCESS) {                     \
+		return ret;                               \
+	}                                             \
+	return overlapWaitSchedule(b, &request);      \
+}
+
+SCHEDULE_IMPLEMENTATION(customIbcast,
+	ibcast(b->sbuf, b->count, MPI_CHAR, b->root, b->comm, request))
+SCHEDULE_IMPLEMENTATION(customIgather,
+	igather(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm, request))
+SCHEDULE_IMPLEMENTATION(customIreduce,
+	ireduce(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->root, b->comm, request))
+SCHEDULE_IMPLEMENTATION(customIscatter,
+	iscatter(b->sbuf, b->count, MPI_CHAR, b->rbuf, b->count, MPI_CHAR, b->root, b->comm, request))
+#undef SCHEDULE_IMPLEMENTATION
+
+/*
+ * The persistent ops are made on their first run on a comm and kept on
+ * it, so the later runs only start and wait, until the buffers, count
+ * or root change or the comm is freed.
+ */
+enum { PERSISTENT_BCAST, PERSISTENT_REDUCE, N_PERSISTENT };
+
+typedef struct {
+	Schedule *request;
+	void *sbuf, *rbuf;
+	int count, root;
+} Persistent;
+
+static int persistentKeyval = MPI_KEYVAL_INVALID;
+static pthread_once_t persistentOnce = PTHREAD_ONCE_INIT;
+
+static int
+freePersistents(MPI_Comm comm, int key, void *attr, void *extra)
+{
+	Persistent *persistents = (Persistent *)attr;
+
+	for (int p = 0; p < N_PERSISTENT; p++) {
+		freePersistent(&persistents[p].request);
+	}
+	free(persistents);
+	return MPI_SUCCESS;
+}
+
+static void
+createPersistentKeyval(void)
+{
+	MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, freePersistents, &persistentKeyval, NULL);
+}
+
+/* the op's entry on b's comm, emptied if made for other buffers */
+static int
+getPersistent(Bench *b, int op, Persistent **persistent)
+{
+	Persistent *persistents = NULL;
+	int found = 0;
+
+	pthread_once(&persistentOnce, createPersistentKeyval);
+	int ret = MPI_Comm_get_attr(b->comm, persistentKeyval, &persistents, &found);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+	if (!found) {
+		persistents = (Persistent *)calloc(N_PERSISTENT, sizeof(Persistent));
+		if (!persistents) {
+			return MPI_ERR_NO_MEM;
+		}
+		ret = MPI_Comm_set_attr(b->comm, persistentKeyval, persistents);
+		if (ret != MPI_SUCCESS) {
+			free(persistents);
+			return ret;
+		}
+	}
+
+	*persistent = &persistents[op];
+	if ((*persistent)->sbuf != b->sbuf || (*persistent)->rbuf != b->rbuf ||
+	    (*persistent)->count != b->count || (*persistent)->root != b->root) {
+		freePersistent(&(*persistent)->request);
+		(*persistent)->sbuf = b->sbuf;
+		(*persistent)->rbuf = b->rbuf;
+		(*persistent)->count = b->count;
+		(*persistent)->root = b->root;
+	}
+	return MPI_SUCCESS;
+}
+
+#define PERSISTENT_IMPLEMENTATION(name, op, init)       \
+static int                                              \
+name##Post(Bench *b, Schedule **request)                \
+{                                                       \
+	Persistent *persistent = NULL;                      \
+	int ret = getPersistent(b, op, &persistent);        \
+	if (ret == MPI_SUCCESS && !persistent->request) {   \
+		ret = init;                                     \
+	}                                                   \
+	if (ret == MPI_SUCCESS) {                           \
+		ret = startSchedule(persistent->request);       \
+	}                                                   \
+	*request = persistent ? persistent->request : NULL; \
+	return ret;                                         \
+}                                                       \
+                                                        \
+static int                                              \
+name(Bench *b)                                          \
+{                                                       \
+	Schedule *request = NULL;                           \
+	int ret = name##Post(b, &request);                  \
+	if (ret != MPI_SUCCESS) {                           \
+		return ret;                                     \
+	}                                                   \
+	return overlapWaitSchedule(b, &request);            \
+}
+
+PERSISTENT_IMPLEMENTATION(customBcastPersistent, PERSISTENT_BCAST,
+	bcastInit(b->sbuf, b->count, MPI_CHAR, b->root, b->comm, &persistent->request))
+PERSISTENT_IMPLEMENTATION(customReducePersistent, PERSISTENT_REDUCE,
+	reduceInit(b->sbuf, b->rbuf, b->count, MPI_CHAR, MPI_SUM, b->root, b->comm, &persistent->request))
+#undef PERSISTENT_IMPLEMENTATION
+
+/*
+ * Point-to-point bodies pair rank r with r + size / 2, so the pairs cross
+ * the emulated nodes of --ranks-per-node size / 2. The single-pair ones
+ * use the pair of rank 0 only, the other ranks return at once.
+ */
+#define P2P_TAG 10
+#define WINDOW  64
+
+static int
+peer(const Bench *b)
+{
+	int half = b->size / 2;
+	if (half == 0 || b->rank >= 2 * half) {
+		return MPI_PROC_NULL;
+	}
+	return b->rank < half ? b->rank + half : b->rank - half;
+}
+
+static int
+pingPong(Bench *b)
+{
+	int to = peer(b);
+	b->messages = 2;
+	if (b->rank == 0) {
+		MPI_Send(b->sbuf, b->count, MPI_CHAR, to, P2P_TAG, b->comm);
+		return MPI_Recv(b->rbuf, b->count, MPI_CHAR, to, P2P_TAG, b->comm, MPI_STATUS_IGNORE);
+	} else if (b->rank == b->size / 2) {
+		MPI_Recv(b->rbuf, b->count, MPI_CHAR, to, P2P_TAG, b->comm, MPI_STATUS_IGNORE);
+		return MPI_Send(b->sbuf, b->count, MPI_CHAR, to, P2P_TAG, b->comm);
+	}
+	return MPI_SUCCESS;
+}
+
+/*
+ * A window of messages in flight from the lower rank of the pair to the
+ * upper one, and back too if bidirectional. The receives of a window all
+ * land in rbuf, only the timing matters.
+ */
+static int
+window(Bench *b, int pairs, int bidirectional)
+{
+	MPI_Request requests[2 * WINDOW];
+	int n = 0, to = peer(b), half = b->size / 2;
+
+	b->messages = WINDOW * pairs * (bidirectional ? 2 : 1);
+	if (to == MPI_PROC_NULL || b->rank % half >= pairs) {
+		return MPI_SUCCESS;
+	}
+
+	for (int w = 0; w < WINDOW && (bidirectional || b->rank >= half); w++) {
+		MPI_Irecv(b->rbuf, b->count, MPI_CHAR, to, P2P_TAG, b->comm, &requests[n++]);
+	}
+	for (int w = 0; w < WINDOW && (bidirectional || b->rank < half); w++) {
+		MPI_Isend(b->sbuf, b->count, MPI_CHAR, to, P2P_TAG, b->comm, &requests[n++]);
+	}
+	return MPI_Waitall(n, requests, MPI_STATUSES_IGNORE);
+}
+
+static int
+bandwidth(Bench *b)
+{
+	return window(b, 1, 0);
+}
+
+static int
+biBandwidth(Bench *b)
+{
+	return window(b, 1, 1);
+}
+
+static int
+multiBandwidth(Bench *b)
+{
+	return window(b, b->size / 2, 0);
+}
+
+const Benchmark benchmarks[] = {
+	{"MPI_Bcast",                mpiBcast},
+	{"MPI_Gather",               mpiGather},
+	{"MPI_Reduce",               mpiReduce},
+	{"MPI_Scatter",              mpiScatter},
+	{"MPI_Allgather",            mpiAllgather,          NULL, 1},
+	{"MPI_Allreduce",            mpiAllreduce},
+	{"MPI_Alltoall",             mpiAlltoall,           NULL, 1},
+	{"MPI_Alltoallv",            mpiAlltoallv,          NULL, 1},
+	{"MPI_Reduce_scatter_block", mpiReduceScatterBlock, NULL, 1},
+	{"MPI_Scan",                 mpiScan},
+	{"MPI_Exscan",               mpiExscan},
+
+	{"bcast",                   customBcast},
+	{"bcast_linear",            customBcastLinear},
+	{"bcast_binomial",          customBcastBinomial},
+	{"bcast_pipeline",          customBcastPipeline},
+	{"bcast_scatter_allgather", customBcastScatterAllgather},
+	{"bcast_shared",            customBcastShared},
+	{"bcast_hierarchical",      customBcastHierarchical},
+	{"gather",                  customGather},
+	{"gather_linear",           customGatherLinear},
+	{"gather_binomial",         customGatherBinomial},
+	{"gather_shared",           customGatherShared},
+	{"gather_hierarchical",     customGatherHierarchical},
+	{"reduce",                  customReduce},
+	{"reduce_linear",           customReduceLinear},
+	{"reduce_binomial",         customReduceBinomial},
+	{"reduce_rabenseifner",     customReduceRabenseifner},
+	{"reduce_shared",           customReduceShared},
+	{"reduce_hierarchical",     customReduceHierarchical},
+	{"scatter",                 customScatter},
+	{"scatter_linear",          customScatterLinear},
+	{"scatter_binomial",        customScatterBinomial},
+	{"scatter_shared",          customScatterShared},
+
+	{"allgather",                    customAllgather,                  NULL, 1},
+	{"allgather_ring",               customAllgatherRing,              NULL, 1},
+	{"allgather_recursive_doubling", customAllgatherRecursiveDoubling, NULL, 1},
+	{"allgather_hierarchical",       customAllgatherHierarchical,      NULL, 1},
+	{"allreduce",                    customAllreduce},
+	{"allreduce_ring",               customAllreduceRing},
+	{"allreduce_recursive_doubling", customAllreduceRecursiveDoubling},
+	{"allreduce_hierarchical",       customAllreduceHierarchical},
+	{"alltoall",                     customAlltoall,                   NULL, 1},
+	{"alltoall_bruck",               customAlltoallBruck,              NULL, 1},
+	{"alltoall_pairwise",            customAlltoallPairwise,           NULL, 1},
+	{"alltoallv",                    customAlltoallv,                  NULL, 1},
+	{"reduce_scatter_block",         customReduceScatterBlock,         NULL, 1},
+	{"scan",                         customScan},
+	{"exscan",                       customExscan},
+
+	{"MPI_Ibcast",     mpiIbcast,      mpiIbcastPost,     0, 1},
+	{"MPI_Igather",    mpiIgather,     mpiIgatherPost,    0, 1},
+	{"MPI_Ireduce",    mpiIreduce,     mpiIreducePost,    0, 1},
+	{"MPI_Iscatter",   mpiIscatter,    mpiIscatterPost,   0, 1},
+	{"MPI_Iallreduce", mpiIallreduce,  mpiIallreducePost, 0, 1},
+	{"ibcast",         customIbcast,   NULL,              0, 1, customIbcastPost},
+	{"igather",        customIgather,  NULL,              0, 1, customIgatherPost},
+	{"ireduce",        customIreduce,  NULL,              0, 1, customIreducePost},
+	{"iscatter",       customIscatter, NULL,              0, 1, customIscatterPost},
+
+	{"bcast_persistent",  customBcastPersistent,  NULL, 0, 1, customBcastPersistentPost},
+	{"reduce_persistent", customReducePersistent, NULL, 0, 1, customReducePersistentPost},
+
+	{"pingpong",       pingPong},
+	{"bandwidth",      bandwidth},
+	{"bibandwidth",    biBandwidth},
+	{"multibandwidth", multiBandwidth},
+};
+
+const int nBenchmarks = sizeof(benchmarks) / sizeof(*benchmarks);
+
+const Benchmark *
+findBenchmark(const char *name)
+{
+	for (int b = 0; b < nBenchmarks; b++) {
+		if (strcmp(benchmarks[b].name, name) == 0) {
+			return &benchmarks[b];
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,456 @@
+#include "check.h"
+#include "collectives.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* rows of the matrix whose columns are the elements of the vector layout */
+#define COLUMN_ROWS 3
+
+typedef enum {
+	FamilyBcast,
+	FamilyGather,
+	FamilyScatter,
+	FamilyAllgather,
+	FamilyAlltoall,
+	FamilyReduce,
+	FamilyAllreduce,
+	FamilyReduceScatter,
+	FamilyScan,
+	FamilyExscan,
+} Family;
+
+typedef int (*BcastFunc)(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm);
+typedef int (*RootedFunc)(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype,
+                          int root, MPI_Comm comm);
+typedef int (*AllFunc)(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype,
+                       MPI_Comm comm);
+typedef int (*ReduceFunc)(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm);
+typedef int (*AllreduceFunc)(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm);
+
+typedef struct {
+	const char *name;
+	Family family;
+	union {
+		BcastFunc bcast;
+		RootedFunc rooted;        /* gather and scatter */
+		AllFunc all;              /* allgather and alltoall */
+		ReduceFunc reduce;
+		AllreduceFunc allreduce;  /* allreduce, reduce_scatter_block and the scans */
+	};
+} Case;
+
+static int
+bcastPipelineDefault(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+	return bcastPipeline(buf, count, type, root, comm, bcastSegment);
+}
+
+/* the non-blocking ones run to completion */
+static int
+ibcastWait(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+	Schedule *request = NULL;
+	int ret = ibcast(buf, count, type, root, comm, &request);
+	return ret == MPI_SUCCESS ? waitSchedule(&request) : ret;
+}
+
+static int
+igatherWait(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root,
+            MPI_Comm comm)
+{
+	Schedule *request = NULL;
+	int ret = igather(sbuf, scount, stype, rbuf, rcount, rtype, root, comm, &request);
+	return ret == MPI_SUCCESS ? waitSchedule(&request) : ret;
+}
+
+static int
+iscatterWait(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root,
+             MPI_Comm comm)
+{
+	Schedule *request = NULL;
+	int ret = iscatter(sbuf, scount, stype, rbuf, rcount, rtype, root, comm, &request);
+	return ret == MPI_SUCCESS ? waitSchedule(&request) : ret;
+}
+
+static int
+ireduceWait(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+	Schedule *request = NULL;
+	int ret = ireduce(sbuf, rbuf, count, type, op, root, comm, &request);
+	return ret == MPI_SUCCESS ? waitSchedule(&request) : ret;
+}
+
+/*
+ * The persistent bcast is started twice, so the restarted requests run
+ * too. The reduce only once, as only the root knows whether it is in
+ * place, where a second start would combine its result again.
+ */
+static int
+bcastStarted(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+	Schedule *request = NULL;
+	int ret = bcastInit(buf, count, type, root, comm, &request);
+	for (int start = 0; start < 2 && ret == MPI_SUCCESS; start++) {
+		ret = startSchedule(request);
+		if (ret == MPI_SUCCESS) {
+			ret = waitSchedule(&request);
+		}
+	}
+	freePersistent(&request);
+	return ret;
+}
+
+static int
+reduceStarted(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+	Schedule *request = NULL;
+	int ret = reduceInit(sbuf, rbuf, count, type, op, root, comm, &request);
+	if (ret == MPI_SUCCESS) {
+		ret = startSchedule(request);
+	}
+	if (ret == MPI_SUCCESS) {
+		ret = waitSchedule(&request);
+	}
+	freePersistent(&request);
+	return ret;
+}
+
+static int
+alltoallvUniform(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype,
+                 MPI_Comm comm)
+{
+	int size = 0;
+	MPI_Comm_size(comm, &size);
+
+	int *scounts = (int *)malloc(4 * (size_t)size * sizeof(int));
+	if (!scounts) {
+		return MPI_ERR_NO_MEM;
+	}
+	int *sdispls = scounts + size, *rcounts = sdispls + size, *rdispls = rcounts + size;
+	for (int i = 0; i < size; i++) {
+		scounts[i] = scount;
+		sdispls[i] = i * scount;
+		rcounts[i] = rcount;
+		rdispls[i] = i * rcount;
+	}
+
+	int ret = alltoallv(sbuf, scounts, sdispls, stype, rbuf, rcounts, rdispls, rtype, comm);
+	free(scounts);
+	return ret;
+}
+
+static const Case cases[] = {
+	{"bcast",                        FamilyBcast,         .bcast = bcast},
+	{"bcast_linear",                 FamilyBcast,         .bcast = bcastLinear},
+	{"bcast_binomial",               FamilyBcast,         .bcast = bcastBinomial},
+	{"bcast_pipeline",               FamilyBcast,         .bcast = bcastPipelineDefault},
+	{"bcast_scatter_allgather",      FamilyBcast,         .bcast = bcastScatterAllgather},
+	{"bcast_shared",                 FamilyBcast,         .bcast = bcastShared},
+	{"bcast_hierarchical",           FamilyBcast,         .bcast = bcastHierarchical},
+	{"ibcast",                       FamilyBcast,         .bcast = ibcastWait},
+	{"bcast_persistent",             FamilyBcast,         .bcast = bcastStarted},
+	{"gather",                       FamilyGather,        .rooted = gather},
+	{"gather_linear",                FamilyGather,        .rooted = gatherLinear},
+	{"gather_binomial",              FamilyGather,        .rooted = gatherBinomial},
+	{"gather_shared",                FamilyGather,        .rooted = gatherShared},
+	{"gather_hierarchical",          FamilyGather,        .rooted = gatherHierarchical},
+	{"igather",                      FamilyGather,        .rooted = igatherWait},
+	{"scatter",                      FamilyScatter,       .rooted = scatter},
+	{"scatter_linear",               FamilyScatter,       .rooted = scatterLinear},
+	{"scatter_binomial",             FamilyScatter,       .rooted = scatterBinomial},
+	{"scatter_shared",               FamilyScatter,       .rooted = scatterShared},
+	{"iscatter",                     FamilyScatter,       .rooted = iscatterWait},
+	{"allgather",                    FamilyAllgather,     .all = allgather},
+	{"allgather_ring",               FamilyAllgather,     .all = allgatherRing},
+	{"allgather_recursive_doubling", FamilyAllgather,     .all = allgatherRecursiveDoubling},
+	{"allgather_hierarchical",       FamilyAllgather,     .all = allgatherHierarchical},
+	{"alltoall",                     FamilyAlltoall,      .all = alltoall},
+	{"alltoall_bruck",               FamilyAlltoall,      .all = alltoallBruck},
+	{"alltoall_pairwise",            FamilyAlltoall,      .all = alltoallPairwise},
+	{"alltoallv",                    FamilyAlltoall,      .all = alltoallvUniform},
+	{"reduce",                       FamilyReduce,        .reduce = reduce},
+	{"reduce_linear",                FamilyReduce,        .reduce = reduceLinear},
+	{"reduce_binomial",              FamilyReduce,        .reduce = reduceBinomial},
+	{"reduce_rabenseifner",          FamilyReduce,        .reduce = reduceRabenseifner},
+	{"reduce_shared",                FamilyReduce,        .reduce = reduceShared},
+	{"reduce_hierarchical",          FamilyReduce,        .reduce = reduceHierarchical},
+	{"ireduce",                      FamilyReduce,        .reduce = ireduceWait},
+	{"reduce_persistent",            FamilyReduce,        .reduce = reduceStarted},
+	{"allreduce",                    FamilyAllreduce,     .allreduce = allreduce},
+	{"allreduce_ring",               FamilyAllreduce,     .allreduce = allreduceRing},
+	{"allreduce_recursive_doubling", FamilyAllreduce,     .allreduce = allreduceRecursiveDoubling},
+	{"allreduce_hierarchical",       FamilyAllreduce,     .allreduce = allreduceHierarchical},
+	{"reduce_scatter_block",         FamilyReduceScatter, .allreduce = reduceScatterBlock},
+	{"scan",                         FamilyScan,          .allreduce = scan},
+	{"exscan",                       FamilyExscan,        .allreduce = exscan},
+};
+
+static int
+isReduction(Family family)
+{
+	return family >= FamilyReduce;
+}
+
+static int
+isRooted(Family family)
+{
+	return family == FamilyBcast || family == FamilyGather || family == FamilyScatter || family == FamilyReduce;
+}
+
+/*
+ * The elements of a buffer: ints, or the columns of a matrix of
+ * COLUMN_ROWS rows, with a spare column on the right none may touch.
+ * Every matrix has widest columns, as many as the largest buffer holds,
+ * so the trees may keep several ranks' blocks in the send type too.
+ */
+typedef struct {
+	MPI_Datatype type;
+	size_t ints;
+} Layout;
+
+static int
+makeLayout(int columns, int elements, int widest, Layout *layout)
+{
+	layout->type = MPI_INT;
+	layout->ints = elements;
+	if (!columns) {
+		return MPI_SUCCESS;
+	}
+
+	MPI_Datatype column;
+	int width = widest + 1;
+	int ret = MPI_Type_vector(COLUMN_ROWS, 1, width, MPI_INT, &column);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+	ret = MPI_Type_create_resized(column, 0, sizeof(int), &layout->type);
+	MPI_Type_free(&column);
+	if (ret == MPI_SUCCESS) {
+		ret = MPI_Type_commit(&layout->type);
+	}
+	if (ret != MPI_SUCCESS) {
+		layout->type = MPI_INT;
+	}
+	layout->ints = (size_t)COLUMN_ROWS * width;
+	return ret;
+}
+
+static void
+freeLayout(Layout *layout)
+{
+	if (layout->type != MPI_INT) {
+		MPI_Type_free(&layout->type);
+	}
+}
+
+/* elements of the send and receive buffers for count per rank, room for the input in place included */
+static void
+shape(Family family, int size, int count, int *sElements, int *rElements)
+{
+	int all = size * count;
+
+	switch (family) {
+		case FamilyBcast:
+			*sElements = count, *rElements = 0;
+			break;
+		case FamilyGather:
+		case FamilyAllgather:
+			*sElements = count, *rElements = all;
+			break;
+		case FamilyScatter:
+			*sElements = all, *rElements = count;
+			break;
+		case FamilyAlltoall:
+		case FamilyReduceScatter:
+			*sElements = all, *rElements = all;
+			break;
+		default:
+			*sElements = count, *rElements = count;
+			break;
+	}
+}
+
+/* the input in place: on the root of the rooted ones, on every rank otherwise */
+static void
+placeInput(Family family, int rank, int root, void **sbuf, void **rbuf)
+{
+	if (family == FamilyScatter) {
+		if (rank == root) {
+			*rbuf = MPI_IN_PLACE;
+		}
+	} else if (!isRooted(family) || rank == root) {
+		*sbuf = MPI_IN_PLACE;
+	}
+}
+
+/* the custom collective of c, or the MPI one if c is NULL */
+static int
+call(const Case *c, Family family, void *sbuf, const Layout *s, void *rbuf, const Layout *r, int count, int root,
+     MPI_Comm comm)
+{
+	switch (family) {
+		case FamilyBcast:
+			return c ? c->bcast(sbuf, count, s->type, root, comm) : MPI_Bcast(sbuf, count, s->type, root, comm);
+		case FamilyGather:
+			return c ? c->rooted(sbuf, count, s->type, rbuf, count, r->type, root, comm)
+			         : MPI_Gather(sbuf, count, s->type, rbuf, count, r->type, root, comm);
+		case FamilyScatter:
+			return c ? c->rooted(sbuf, count, s->type, rbuf, count, r->type, root, comm)
+			         : MPI_Scatter(sbuf, count, s->type, rbuf, count, r->type, root, comm);
+		case FamilyAllgather:
+			return c ? c->all(sbuf, count, s->type, rbuf, count, r->type, comm)
+			         : MPI_Allgather(sbuf, count, s->type, rbuf, count, r->type, comm);
+		case FamilyAlltoall:
+			return c ? c->all(sbuf, count, s->type, rbuf, count, r->type, comm)
+			         : MPI_Alltoall(sbuf, count, s->type, rbuf, count, r->type, comm);
+		case FamilyReduce:
+			return c ? c->reduce(sbuf, rbuf, count, s->type, MPI_SUM, root, comm)
+			         : MPI_Reduce(sbuf, rbuf, count, s->type, MPI_SUM, root, comm);
+		case FamilyAllreduce:
+			return c ? c->allreduce(sbuf, rbuf, count, s->type, MPI_SUM, comm)
+			         : MPI_Allreduce(sbuf, rbuf, count, s->type, MPI_SUM, comm);
+		case FamilyReduceScatter:
+			return c ? c->allreduce(sbuf, rbuf, count, s->type, MPI_SUM, comm)
+			         : MPI_Reduce_scatter_block(sbuf, rbuf, count, s->type, MPI_SUM, comm);
+		case FamilyScan:
+			return c ? c->allreduce(sbuf, rbuf, count, s->type, MPI_SUM, comm)
+			         : MPI_Scan(sbuf, rbuf, count, s->type, MPI_SUM, comm);
+		case FamilyExscan:
+			return c ? c->allreduce(sbuf, rbuf, count, s->type, MPI_SUM, comm)
+			         : MPI_Exscan(sbuf, rbuf, count, s->type, MPI_SUM, comm);
+	}
+	return MPI_ERR_OTHER;
+}
+
+/* distinct on every rank and between the send and receive buffers, small enough to sum */
+static void
+fill(int *buf, size_t ints, int rank, int seed)
+{
+	for (size_t i = 0; i < ints; i++) {
+		buf[i] = (rank + 1) * 1000 + (int)(i % 997) + seed;
+	}
+}
+
+/*
+ * Runs c and the MPI collective on the same input and sets *verdict to 0
+ * if every buffer of this rank came out the same, 1 if not and 2 if c
+ * failed. Exscan leaves rank 0's result undefined, so it is not compared.
+ */
+static Error
+checkRun(const Case *c, int columns, int count, int inPlace, int root, MPI_Comm comm, int *verdict)
+{
+	Error error = OK;
+	int rank = 0, size = 0;
+	int sElements = 0, rElements = 0;
+	Layout s = {MPI_INT}, r = {MPI_INT};
+	int *bufs[4] = {NULL};
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	shape(c->family, size, count, &sElements, &rElements);
+
+	int widest = size * count;
+	if (makeLayout(columns, sElements, widest, &s) != MPI_SUCCESS ||
+	    makeLayout(columns, rElements, widest, &r) != MPI_SUCCESS) {
+		error = ErrMpi;
+		goto OUT;
+	}
+	for (int b = 0; b < 4; b++) {
+		bufs[b] = (int *)malloc(((b % 2 ? r.ints : s.ints) + 1) * sizeof(int));
+		if (!bufs[b]) {
+			error = ErrOutOfMemory;
+		}
+	}
+	if (error != OK) {
+		goto OUT;
+	}
+
+	/* the MPI run in bufs 0 and 1, the custom one in 2 and 3 */
+	for (int b = 0; b < 4; b++) {
+		fill(bufs[b], b % 2 ? r.ints : s.ints, rank, b % 2 ? 500000 : 0);
+	}
+	void *sbufs[2] = {bufs[0], bufs[2]}, *rbufs[2] = {bufs[1], bufs[3]};
+	if (inPlace) {
+		placeInput(c->family, rank, root, &sbufs[0], &rbufs[0]);
+		placeInput(c->family, rank, root, &sbufs[1], &rbufs[1]);
+	}
+
+	if (call(NULL, c->family, sbufs[0], &s, rbufs[0], &r, count, root, comm) != MPI_SUCCESS) {
+		error = ErrMpi;
+		goto OUT;
+	}
+	if (call(c, c->family, sbufs[1], &s, rbufs[1], &r, count, root, comm) != MPI_SUCCESS) {
+		*verdict = 2;
+		goto OUT;
+	}
+
+	int compareResult = c->family != FamilyExscan || rank != 0;
+	*verdict = memcmp(bufs[0], bufs[2], s.ints * sizeof(int)) != 0 ||
+	           (compareResult && memcmp(bufs[1], bufs[3], r.ints * sizeof(int)) != 0);
+
+OUT:
+	for (int b = 0; b < 4; b++) {
+		free(bufs[b]);
+	}
+	freeLayout(&s);
+	freeLayout(&r);
+	return error;
+}
+
+Error
+checkCollectives(MPI_Comm comm, const long *sizes, int nSizes)
+{
+	Error error = OK;
+	int rank = 0, size = 0;
+	int runs = 0, differing = 0;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+
+	for (int s = 0; s < nSizes && error == OK; s++) {
+		for (int columns = 0; columns < 2 && error == OK; columns++) {
+			int count = sizes[s] / (long)(sizeof(int) * (columns ? COLUMN_ROWS : 1));
+			count = count > 0 ? count : 1;
+
+			for (int c = 0; c < sizeof(cases) / sizeof(*cases) && error == OK; c++) {
+				const Case *cs = &cases[c];
+				if (columns && isReduction(cs->family)) {
+					continue;
+				}
+
+				for (int inPlace = 0; inPlace < 2 && error == OK; inPlace++) {
+					if (inPlace && cs->family == FamilyBcast) {
+						continue;
+					}
+
+					/* the first rank and the last, which rotates the trees */
+					for (int root = 0; root < size && error == OK; root += size > 1 ? size - 1 : 1) {
+						int verdict = 0;
+						error = checkRun(cs, columns, count, inPlace, root, comm, &verdict);
+						MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, comm);
+						MPI_Allreduce(MPI_IN_PLACE, &verdict, 1, MPI_INT, MPI_MAX, comm);
+
+						runs++;
+						if (verdict) {
+							differing++;
+						}
+						if (rank == 0 && verdict) {
+							printf("%s (%ld bytes, %s%s, root %d):\t%s\n", cs->name, sizes[s],
+							       columns ? "vector columns" : "ints", inPlace ? ", in place" : "", root,
+							       verdict == 2 ? "failed" : "differs from MPI");
+						}
+						if (!isRooted(cs->family)) {
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if (rank == 0 && error == OK) {
+		printf("Checked %d runs against MPI, %d differ\n", runs, differing);
+	}
+	return error != OK ? error : differing ? ErrMismatch : OK;
+}
@@ -0,0 +1,17 @@
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include "bench.h"
+
+/*
+ * Runs every custom collective, each of its variants and the non-blocking
+ * and persistent ones, on sizes bytes per rank of ints, of the columns of
+ * a matrix as a resized MPI_Type_vector, and with MPI_IN_PLACE, then
+ * compares the buffers of every rank against those of the MPI collective
+ * on the same input. The reductions take ints only, as findReduction does.
+ * Collective over comm, each differing run is printed on rank 0.
+ */
+Error
+checkCollectives(MPI_Comm comm, const long *sizes, int nSizes);
+
+#endif
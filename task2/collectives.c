@@ -0,0 +1,2980 @@
+#include "collectives.h"
+#include "datatype.h"
+#include "reduction.h"
+#include "shared.h"
+#include "topology.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <mpi.h>
+
+/* in the order of the variant tables of the entry points below */
+const Tunable tunables[] = {
+	{"bcast",     {"linear", "binomial", "pipeline", "scatter_allgather", "shared", "hierarchical"}},
+	{"gather",    {"linear", "binomial", "shared", "hierarchical"}},
+	{"reduce",    {"linear", "binomial", "rabenseifner", "shared", "hierarchical"}},
+	{"allgather", {"ring", "recursive_doubling", "hierarchical"}},
+	{"allreduce", {"ring", "recursive_doubling", "hierarchical"}},
+	{"alltoall",  {"bruck", "pairwise"}},
+	{"scatter",   {"linear", "binomial", "shared"}},
+};
+
+const int nTunables = sizeof(tunables) / sizeof(*tunables);
+
+enum {
+	TunedBcast = 0,
+	TunedGather,
+	TunedReduce,
+	TunedAllgather,
+	TunedAllreduce,
+	TunedAlltoall,
+	TunedScatter,
+};
+
+typedef struct {
+	int collective, commSize;
+	long bytes;
+	int variant;
+} Decision;
+
+static Decision *decisions;
+static int nDecisions;
+
+static int
+findName(const char *const *names, int n, const char *name)
+{
+	for (int i = 0; i < n && names[i]; i++) {
+		if (strcmp(names[i], name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static int
+parseDecisions(char *text, Decision **parsed, int *n)
+{
+	int max = 0;
+
+	*parsed = NULL;
+	*n = 0;
+	for (char *line = strtok(text, "\n"); line; line = strtok(NULL, "\n")) {
+		char collective[32], variant[32];
+		Decision decision;
+
+		if (line[strspn(line, " \t")] == '#' || line[strspn(line, " \t")] == '\0') {
+			continue;
+		}
+		if (sscanf(line, "%31s %d %ld %31s", collective, &decision.commSize, &decision.bytes, variant) != 4) {
+			return MPI_ERR_ARG;
+		}
+
+		decision.collective = -1;
+		for (int t = 0; t < nTunables; t++) {
+			if (strcmp(tunables[t].name, collective) == 0) {
+				decision.collective = t;
+			}
+		}
+		if (decision.collective < 0) {
+			return MPI_ERR_ARG;
+		}
+		decision.variant = findName(tunables[decision.collective].variants, MAX_VARIANTS, variant);
+		if (decision.variant < 0) {
+			return MPI_ERR_ARG;
+		}
+
+		if (*n == max) {
+			max = max ? 2 * max : 64;
+			Decision *more = (Decision *)realloc(*parsed, max * sizeof(Decision));
+			if (!more) {
+				return MPI_ERR_NO_MEM;
+			}
+			*parsed = more;
+		}
+		(*parsed)[(*n)++] = decision;
+	}
+	return MPI_SUCCESS;
+}
+
+/* rank 0 reads the file for all, so that every rank takes the same decisions */
+int
+loadDecisions(const char *path, MPI_Comm comm)
+{
+	int rank = 0;
+	long length = -1;
+	char *text = NULL;
+
+	MPI_Comm_rank(comm, &rank);
+	if (rank == 0) {
+		FILE *in = fopen(path, "r");
+		if (in && fseek(in, 0, SEEK_END) == 0 && (length = ftell(in)) >= 0 && fseek(in, 0, SEEK_SET) == 0) {
+			text = (char *)malloc(length + 1);
+			if (!text || fread(text, 1, length, in) != (size_t)length) {
+				length = -1;
+			}
+		}
+		if (in) {
+			fclose(in);
+		}
+	}
+
+	MPI_Bcast(&length, 1, MPI_LONG, 0, comm);
+	if (length < 0) {
+		free(text);
+		return MPI_ERR_FILE;
+	}
+	if (rank != 0) {
+		text = (char *)malloc(length + 1);
+	}
+	int ok = text != NULL;
+	MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+	if (!ok) {
+		free(text);
+		return MPI_ERR_NO_MEM;
+	}
+	MPI_Bcast(text, length, MPI_CHAR, 0, comm);
+	text[length] = '\0';
+
+	Decision *parsed = NULL;
+	int n = 0;
+	int ret = parseDecisions(text, &parsed, &n);
+	free(text);
+	if (ret != MPI_SUCCESS) {
+		free(parsed);
+		return ret;
+	}
+
+	free(decisions);
+	decisions = parsed;
+	nDecisions = n;
+	return MPI_SUCCESS;
+}
+
+/*
+ * The variant tuned for the nearest comm size and the largest message
+ * size not above bytes, or the smallest one if all are; -1 without a
+ * decision for collective, to fall back to the built-in thresholds.
+ */
+static int
+decide(int collective, MPI_Comm comm, long bytes)
+{
+	const Decision *best = NULL;
+	int size = 0;
+
+	if (nDecisions == 0) {
+		return -1;
+	}
+	MPI_Comm_size(comm, &size);
+
+	for (int d = 0; d < nDecisions; d++) {
+		const Decision *decision = &decisions[d];
+		if (decision->collective != collective) {
+			continue;
+		}
+		if (!best) {
+			best = decision;
+			continue;
+		}
+
+		int distance = abs(decision->commSize - size), bestDistance = abs(best->commSize - size);
+		int fits = decision->bytes <= bytes, bestFits = best->bytes <= bytes;
+		if (distance != bestDistance) {
+			best = distance < bestDistance ? decision : best;
+		} else if (fits != bestFits) {
+			best = fits ? decision : best;
+		} else if (fits ? decision->bytes > best->bytes : decision->bytes < best->bytes) {
+			best = decision;
+		}
+	}
+	return best ? best->variant : -1;
+}
+
+#define BCAST_TAG 1
+
+#define BCAST_LONG_MSG (256 * 1024)
+
+int bcastSegment = 64 * 1024;
+
+typedef int (*BcastVariant)(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm);
+
+static int
+bcastPipelineSegment(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+	return bcastPipeline(buf, count, type, root, comm, bcastSegment);
+}
+
+static const BcastVariant bcastVariants[] = {
+	bcastLinear, bcastBinomial, bcastPipelineSegment, bcastScatterAllgather, bcastShared, bcastHierarchical,
+};
+
+/* whether the *Shared variants run through a window, rather than fall back to messages */
+static int
+sharesMemory(MPI_Comm comm)
+{
+	Segment *segment = NULL;
+	return getSegment(comm, &segment) == MPI_SUCCESS && segment;
+}
+
+int hierarchyRanksPerNode = 0;
+
+static int topologyKeyval = MPI_KEYVAL_INVALID;
+static pthread_once_t topologyOnce = PTHREAD_ONCE_INIT;
+
+static int
+freeCachedTopology(MPI_Comm comm, int key, void *attr, void *extra)
+{
+	freeTopology((Topology *)attr);
+	free(attr);
+	return MPI_SUCCESS;
+}
+
+static void
+createTopologyKeyval(void)
+{
+	MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, freeCachedTopology, &topologyKeyval, NULL);
+}
+
+/* the nodes of comm, split on the first call, which is collective, and cached on the comm */
+static int
+getTopology(MPI_Comm comm, const Topology **topo)
+{
+	Topology *cached = NULL;
+	int found = 0;
+
+	pthread_once(&topologyOnce, createTopologyKeyval);
+	int ret = MPI_Comm_get_attr(comm, topologyKeyval, &cached, &found);
+	if (ret != MPI_SUCCESS || found) {
+		*topo = cached;
+		return ret;
+	}
+
+	cached = (Topology *)malloc(sizeof(Topology));
+	if (!cached) {
+		return MPI_ERR_NO_MEM;
+	}
+	ret = splitTopology(comm, hierarchyRanksPerNode, cached);
+	if (ret != MPI_SUCCESS) {
+		free(cached);
+		return ret;
+	}
+	ret = MPI_Comm_set_attr(comm, topologyKeyval, cached);
+	if (ret != MPI_SUCCESS) {
+		freeCachedTopology(comm, topologyKeyval, cached, NULL);
+		return ret;
+	}
+
+	*topo = cached;
+	return MPI_SUCCESS;
+}
+
+/* whether comm spans nodes with more than a rank on some, so the *Hierarchical variants pay off */
+static int
+spansNodes(MPI_Comm comm)
+{
+	const Topology *topo = NULL;
+	int size = 0;
+
+	MPI_Comm_size(comm, &size);
+	return getTopology(comm, &topo) == MPI_SUCCESS && topo->nNodes > 1 && topo->nNodes < size;
+}
+
+/* the blocks of count elements of the ranks of node, in a buffer of a block per rank of the comm */
+static int
+nodeBlocks(const Topology *topo, int node, int count, MPI_Datatype type, MPI_Datatype *blocks)
+{
+	MPI_Datatype block;
+
+	MPI_Type_contiguous(count, type, &block);
+	MPI_Type_create_indexed_block(topo->firstMember[node + 1] - topo->firstMember[node], 1,
+	                              topo->members + topo->firstMember[node], block, blocks);
+	MPI_Type_free(&block);
+	return MPI_Type_commit(blocks);
+}
+
+/*
+ * MPI_IN_PLACE for the block of a rank of a gather, scatter or allgather,
+ * which is then block of the bcount elements of btype at blocks.
+ */
+static void
+inPlaceBlock(void **buf, int *count, MPI_Datatype *type, void *blocks, int bcount, MPI_Datatype btype, int block)
+{
+	MPI_Aint lb = 0, extent = 0;
+
+	if (*buf == MPI_IN_PLACE) {
+		MPI_Type_get_extent(btype, &lb, &extent);
+		*buf = (char *)blocks + (MPI_Aint)block * bcount * extent;
+		*count = bcount;
+		*type = btype;
+	}
+}
+
+/*
+ * The bytes of count elements of type at buf for the *Shared variants,
+ * which copy chunks of them, in *data: buf itself if contiguous, otherwise
+ * a packed copy, of buf if pack, to unpack once done otherwise. *packed is
+ * to free, even on failure.
+ */
+static int
+sharedBytes(void *buf, int count, MPI_Datatype type, int pack, char **data, char **packed)
+{
+	int tsize = 0;
+
+	*packed = NULL;
+	if (isContiguous(type)) {
+		*data = (char *)buf;
+		return MPI_SUCCESS;
+	}
+	MPI_Type_size(type, &tsize);
+	*data = *packed = (char *)malloc((size_t)count * tsize + 1);
+	if (!*packed) {
+		return MPI_ERR_NO_MEM;
+	}
+	return pack ? copyTyped(buf, count, type, *packed, count * tsize, MPI_BYTE) : MPI_SUCCESS;
+}
+
+/* a tree for short messages, then pipelining the segments down a chain */
+static int
+bcastMessages(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+	int tsize = 0;
+	MPI_Type_size(type, &tsize);
+
+	if ((long)count * tsize < BCAST_LONG_MSG) {
+		return bcastBinomial(buf, count, type, root, comm);
+	}
+	return bcastPipeline(buf, count, type, root, comm, bcastSegment);
+}
+
+/*
+ * In two levels across nodes, through the shared window on a single
+ * one, otherwise by messages, unless tuned.
+ */
+int
+bcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+	int tsize = 0;
+	int ret = MPI_Type_size(type, &tsize);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+
+	int variant = decide(TunedBcast, comm, (long)count * tsize);
+	if (variant >= 0) {
+		return bcastVariants[variant](buf, count, type, root, comm);
+	}
+	if (spansNodes(comm)) {
+		return bcastHierarchical(buf, count, type, root, comm);
+	}
+	if (sharesMemory(comm)) {
+		return bcastShared(buf, count, type, root, comm);
+	}
+	return bcastMessages(buf, count, type, root, comm);
+}
+
+int
+bcastLinear(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	if (rank == root) {
+		
+		int size = 0;
+		MPI_Comm_size(comm, &size);
+
+		for (int rank = 0; rank < size; rank++) {
+			if (rank == root) {
+				continue;
+			}
+
+			ret = MPI_Send(buf, count, type, rank, BCAST_TAG, comm);
+			if (ret != MPI_SUCCESS) {
+				goto OUT;
+			}
+		}
+
+	} else {
+		MPI_Status status = {};
+		ret = MPI_Recv(buf, count, type, root, BCAST_TAG, comm, &status);
+	}
+
+OUT:
+	MPI_Barrier(comm);
+	return ret;
+}
+
+/*
+ * Ranks are taken relative to the root: a rank receives from the one
+ * that differs in its lowest set bit, then sends to rank + mask for the
+ * masks below that bit, so the data reaches everyone in ceil(log2 P) steps.
+ */
+int
+bcastBinomial(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	int vrank = (rank - root + size) % size;
+	int mask = 1;
+
+	for (; mask < size; mask <<= 1) {
+		if (vrank & mask) {
+			int parent = (rank - mask + size) % size;
+			ret = MPI_Recv(buf, count, type, parent, BCAST_TAG, comm, MPI_STATUS_IGNORE);
+			if (ret != MPI_SUCCESS) {
+				goto OUT;
+			}
+			break;
+		}
+	}
+
+	for (mask >>= 1; mask > 0; mask >>= 1) {
+		if (vrank + mask < size) {
+			int child = (rank + mask) % size;
+			ret = MPI_Send(buf, count, type, child, BCAST_TAG, comm);
+			if (ret != MPI_SUCCESS) {
+				goto OUT;
+			}
+		}
+	}
+
+OUT:
+	return ret;
+}
+
+/*
+ * The chain runs through the ranks relative to the root. Every rank but
+ * the root receives segment i + 1 while it forwards segment i, so after
+ * the chain fills each link carries a segment per step.
+ */
+int
+bcastPipeline(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, int segment)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	MPI_Request recvs[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL},
+	            sends[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	MPI_Aint lb = 0, extent = 0;
+	int tsize = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+	MPI_Type_size(type, &tsize);
+
+	int segCount = tsize > 0 && segment / tsize > 0 ? segment / tsize : 1;
+	int nSegs = (count + segCount - 1) / segCount;
+
+	int vrank = (rank - root + size) % size;
+	int prev = (rank - 1 + size) % size, next = (rank + 1) % size;
+
+	#define SEG_BUF(i)   ((char *)buf + (MPI_Aint)(i) * segCount * extent)
+	#define SEG_COUNT(i) ((i) == nSegs - 1 ? count - (i) * segCount : segCount)
+
+	if (vrank != 0 && nSegs > 0) {
+		MPI_Irecv(SEG_BUF(0), SEG_COUNT(0), type, prev, BCAST_TAG, comm, &recvs[0]);
+	}
+
+	for (int i = 0; i < nSegs; i++) {
+		if (vrank != 0) {
+			if (i + 1 < nSegs) {
+				MPI_Irecv(SEG_BUF(i + 1), SEG_COUNT(i + 1), type, prev, BCAST_TAG, comm,
+				          &recvs[(i + 1) % 2]);
+			}
+			ret = MPI_Wait(&recvs[i % 2], MPI_STATUS_IGNORE);
+			if (ret != MPI_SUCCESS) {
+				goto OUT;
+			}
+		}
+		if (vrank + 1 < size) {
+			ret = MPI_Wait(&sends[i % 2], MPI_STATUS_IGNORE);
+			if (ret != MPI_SUCCESS) {
+				goto OUT;
+			}
+			MPI_Isend(SEG_BUF(i), SEG_COUNT(i), type, next, BCAST_TAG, comm, &sends[i % 2]);
+		}
+	}
+
+	#undef SEG_BUF
+	#undef SEG_COUNT
+
+OUT:
+	MPI_Waitall(2, recvs, MPI_STATUSES_IGNORE);
+	MPI_Waitall(2, sends, MPI_STATUSES_IGNORE);
+	return ret;
+}
+
+/*
+ * van de Geijn: a binomial scatter of the buffer in P blocks, block v
+ * going to the rank v away from the root, then a ring allgather of the
+ * blocks. About 2 * n bytes per rank instead of n * log2 P down a tree.
+ */
+int
+bcastScatterAllgather(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	MPI_Aint lb = 0, extent = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+
+	int vrank = (rank - root + size) % size;
+	int block = (count + size - 1) / size;
+
+	#define BLOCK_BUF(v)   ((char *)buf + (MPI_Aint)(v) * block * extent)
+	#define BLOCK_COUNT(v) ((v) * block >= count ? 0 : \
+	                        count - (v) * block < block ? count - (v) * block : block)
+
+	/* the scatter, a rank ends up with its block and those of its subtree */
+	int have = vrank == 0 ? count : 0;
+	int mask = 1;
+	for (; mask < size; mask <<= 1) {
+		if (vrank & mask) {
+			int want = count - vrank * block;
+			if (want > 0) {
+				MPI_Status status;
+				int parent = (rank - mask + size) % size;
+				ret = MPI_Recv(BLOCK_BUF(vrank), want, type, parent, BCAST_TAG, comm, &status);
+				if (ret != MPI_SUCCESS) {
+					goto OUT;
+				}
+				MPI_Get_count(&status, type, &have);
+			}
+			break;
+		}
+	}
+	for (mask >>= 1; mask > 0; mask >>= 1) {
+		if (vrank + mask < size) {
+			int give = have - block * mask;
+			if (give > 0) {
+				int child = (rank + mask) % size;
+				ret = MPI_Send(BLOCK_BUF(vrank + mask), give, type, child, BCAST_TAG, comm);
+				if (ret != MPI_SUCCESS) {
+					goto OUT;
+				}
+				have -= give;
+			}
+		}
+	}
+
+	/* the ring, at step i a rank passes on the block it got at step i - 1 */
+	int left = (rank - 1 + size) % size, right = (rank + 1) % size;
+	for (int i = 0; i < size - 1; i++) {
+		int out = (vrank - i + size) % size, in = (vrank - i - 1 + size) % size;
+		ret = MPI_Sendrecv(BLOCK_BUF(out), BLOCK_COUNT(out), type, right, BCAST_TAG,
+		                   BLOCK_BUF(in), BLOCK_COUNT(in), type, left, BCAST_TAG,
+		                   comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+	#undef BLOCK_BUF
+	#undef BLOCK_COUNT
+
+OUT:
+	return ret;
+}
+
+/*
+ * The root copies each chunk into its slot and the others copy it out,
+ * while the root fills the other half with the next chunk. Ranks that
+ * do not share memory fall back to the binomial tree.
+ */
+int
+bcastShared(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, tsize = 0;
+	Segment *segment = NULL;
+	char *packed = NULL;
+
+	ret = getSegment(comm, &segment);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (!segment) {
+		return bcastBinomial(buf, count, type, root, comm);
+	}
+	MPI_Comm_rank(comm, &rank);
+	MPI_Type_size(type, &tsize);
+
+	size_t bytes = (size_t)count * tsize;
+	char *data = NULL;
+	ret = sharedBytes(buf, count, type, rank == root, &data, &packed);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	for (size_t off = 0; off < bytes; off += chunkBytes(segment)) {
+		size_t n = bytes - off < chunkBytes(segment) ? bytes - off : chunkBytes(segment);
+		if (rank == root) {
+			waitWritable(segment);
+			memcpy(chunkSlot(segment, root), data + off, n);
+		} else {
+			waitStep(segment, root, 1);
+			memcpy(data + off, chunkSlot(segment, root), n);
+		}
+		postStep(segment, 1);
+		nextChunk(segment, 1);
+	}
+	if (packed && rank != root) {
+		ret = copyTyped(packed, bytes, MPI_BYTE, buf, count, type);
+	}
+
+OUT:
+	free(packed);
+	return ret;
+}
+
+/*
+ * Within the node of the root, then among the leaders from the leader
+ * of that node, then within every other node from its leader, so a
+ * single rank per node takes part across nodes.
+ */
+int
+bcastHierarchical(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	const Topology *topo = NULL;
+
+	ret = getTopology(comm, &topo);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (topo->nNodes == 1) {
+		return bcastShared(buf, count, type, root, comm);
+	}
+
+	int rootNode = topo->nodeOf[root];
+	if (topo->node == rootNode) {
+		ret = bcast(buf, count, type, topo->nodeRankOf[root], topo->nodeComm);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+	if (topo->leaderComm != MPI_COMM_NULL) {
+		ret = bcastMessages(buf, count, type, rootNode, topo->leaderComm);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+	if (topo->node != rootNode) {
+		ret = bcast(buf, count, type, 0, topo->nodeComm);
+	}
+
+OUT:
+	return ret;
+}
+
+#define GATHER_TAG 2
+
+typedef int (*GatherVariant)(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype,
+                             int root, MPI_Comm comm);
+
+static const GatherVariant gatherVariants[] = {
+	gatherLinear, gatherBinomial, gatherShared, gatherHierarchical,
+};
+
+/* in two levels across nodes, through the shared window on a single one, otherwise a tree, unless tuned */
+int
+gather(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm)
+{
+	int rank = 0, ssize = 0;
+	MPI_Comm_rank(comm, &rank);
+	if (rank == root) {
+		inPlaceBlock(&sbuf, &scount, &stype, rbuf, rcount, rtype, root);
+	}
+	MPI_Type_size(stype, &ssize);
+
+	int variant = decide(TunedGather, comm, (long)scount * ssize);
+	if (variant >= 0) {
+		return gatherVariants[variant](sbuf, scount, stype, rbuf, rcount, rtype, root, comm);
+	}
+	if (spansNodes(comm)) {
+		return gatherHierarchical(sbuf, scount, stype, rbuf, rcount, rtype, root, comm);
+	}
+	if (sharesMemory(comm)) {
+		return gatherShared(sbuf, scount, stype, rbuf, rcount, rtype, root, comm);
+	}
+	return gatherBinomial(sbuf, scount, stype, rbuf, rcount, rtype, root, comm);
+}
+
+int
+gatherLinear(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	if (rank == root) {
+
+		MPI_Status status;
+		int size = 0;
+		
+		MPI_Comm_size(comm, &size);
+
+		MPI_Aint lb = 0, rextent = 0;
+		ret = MPI_Type_get_extent(rtype, &lb, &rextent);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+
+		inPlaceBlock(&sbuf, &scount, &stype, rbuf, rcount, rtype, root);
+		ret = copyTyped(sbuf, scount, stype, (char *)rbuf + (MPI_Aint)root * rcount * rextent, rcount, rtype);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+
+		/* in the order the blocks come, each straight into its place */
+		for (int ranks = 0; ranks < size-1; ranks++) {
+			ret = MPI_Probe(MPI_ANY_SOURCE, GATHER_TAG, comm, &status);
+			if (ret != MPI_SUCCESS) {
+				goto OUT;
+			}
+			MPI_Aint off = (MPI_Aint)status.MPI_SOURCE * rcount * rextent;
+			ret = MPI_Recv((char *)rbuf + off, rcount, rtype, status.MPI_SOURCE, GATHER_TAG, comm, MPI_STATUS_IGNORE);
+			if (ret != MPI_SUCCESS) {
+				goto OUT;
+			}
+		}
+
+	} else {
+		ret = MPI_Send(sbuf, scount, stype, root, GATHER_TAG, comm);
+	}
+
+OUT:
+	MPI_Barrier(comm);
+	return ret;
+}
+
+/*
+ * The blocks of the subtree of the root's child at rank child, wrapping
+ * around the last rank, as one committed type; MPI_DATATYPE_NULL on failure.
+ */
+static int
+wrappedBlocks(int child, int blocks, int size, int count, MPI_Aint extent, MPI_Datatype type, MPI_Datatype *wrapped)
+{
+	int lengths[2] = {(size - child) * count, (child + blocks - size) * count};
+	MPI_Aint displacements[2] = {(MPI_Aint)child * count * extent, 0};
+
+	int ret = MPI_Type_create_hindexed(2, lengths, displacements, type, wrapped);
+	if (ret != MPI_SUCCESS) {
+		*wrapped = MPI_DATATYPE_NULL;
+		return ret;
+	}
+	ret = MPI_Type_commit(wrapped);
+	if (ret != MPI_SUCCESS) {
+		MPI_Type_free(wrapped);
+		*wrapped = MPI_DATATYPE_NULL;
+	}
+	return ret;
+}
+
+/*
+ * The bcast tree upside down: a rank of relative rank v gathers the blocks
+ * of v .. v + lowbit(v) - 1 from its children, smallest subtree first, and
+ * sends them on to its parent in one message. Leaves send sbuf as is and
+ * the root receives every subtree straight into rbuf; a subtree that
+ * wraps around the last rank lands through a two-block datatype.
+ */
+int
+gatherBinomial(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	char *tmp = NULL;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	int vrank = (rank - root + size) % size;
+	int subtree = vrank == 0 ? size : vrank & -vrank;
+	if (subtree > size - vrank) {
+		subtree = size - vrank;
+	}
+	if (vrank == 0) {
+		inPlaceBlock(&sbuf, &scount, &stype, rbuf, rcount, rtype, root);
+	}
+
+	MPI_Aint lb = 0, sextent = 0, rextent = 0;
+	MPI_Type_get_extent(stype, &lb, &sextent);
+
+	if (vrank == 0) {
+		MPI_Type_get_extent(rtype, &lb, &rextent);
+		ret = copyTyped(sbuf, scount, stype, (char *)rbuf + (MPI_Aint)root * rcount * rextent, rcount, rtype);
+	} else if (subtree > 1) {
+		tmp = allocTyped(subtree * scount, stype);
+		if (!tmp) {
+			ret = MPI_ERR_NO_MEM;
+			goto OUT;
+		}
+		ret = copyTyped(sbuf, scount, stype, tmp, scount, stype);
+	}
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	int have = 1;
+	for (int mask = 1; mask < size; mask <<= 1) {
+		if (vrank & mask) {
+			int parent = (rank - mask + size) % size;
+			ret = MPI_Send(tmp ? tmp : sbuf, have * scount, stype, parent, GATHER_TAG, comm);
+			break;
+		}
+		if (vrank + mask >= size) {
+			continue;
+		}
+
+		int child = (rank + mask) % size;
+		int blocks = size - vrank - mask < mask ? size - vrank - mask : mask;
+		if (vrank != 0) {
+			ret = MPI_Recv(tmp + (MPI_Aint)mask * scount * sextent, blocks * scount, stype, child, GATHER_TAG, comm,
+			               MPI_STATUS_IGNORE);
+		} else if (child + blocks <= size) {
+			ret = MPI_Recv((char *)rbuf + (MPI_Aint)child * rcount * rextent, blocks * rcount, rtype, child,
+			               GATHER_TAG, comm, MPI_STATUS_IGNORE);
+		} else {
+			MPI_Datatype wrapped;
+			ret = wrappedBlocks(child, blocks, size, rcount, rextent, rtype, &wrapped);
+			if (ret == MPI_SUCCESS) {
+				ret = MPI_Recv(rbuf, 1, wrapped, child, GATHER_TAG, comm, MPI_STATUS_IGNORE);
+				MPI_Type_free(&wrapped);
+			}
+		}
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		have += blocks;
+	}
+
+OUT:
+	freeTyped(tmp, stype);
+	return ret;
+}
+
+/* every rank copies each chunk of its block into its slot and the root copies them all out */
+int
+gatherShared(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0, ssize = 0;
+	Segment *segment = NULL;
+	char *packed = NULL;
+
+	ret = getSegment(comm, &segment);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (!segment) {
+		return gatherBinomial(sbuf, scount, stype, rbuf, rcount, rtype, root, comm);
+	}
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	if (rank == root) {
+		inPlaceBlock(&sbuf, &scount, &stype, rbuf, rcount, rtype, root);
+	}
+	MPI_Type_size(stype, &ssize);
+
+	/* the bytes of this rank's block, or of all the blocks on the root */
+	size_t bytes = (size_t)scount * ssize;
+	char *data = NULL;
+	ret = rank == root ? sharedBytes(rbuf, size * rcount, rtype, 0, &data, &packed)
+	                   : sharedBytes(sbuf, scount, stype, 1, &data, &packed);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (rank == root) {
+		ret = copyTyped(sbuf, scount, stype, data + root * bytes, bytes, MPI_BYTE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+	for (size_t off = 0; off < bytes; off += chunkBytes(segment)) {
+		size_t n = bytes - off < chunkBytes(segment) ? bytes - off : chunkBytes(segment);
+		if (rank != root) {
+			waitWritable(segment);
+			memcpy(chunkSlot(segment, rank), data + off, n);
+		} else {
+			for (int r = 0; r < size; r++) {
+				if (r != root) {
+					waitStep(segment, r, 1);
+					memcpy(data + r * bytes + off, chunkSlot(segment, r), n);
+				}
+			}
+		}
+		postStep(segment, 1);
+		nextChunk(segment, 1);
+	}
+	if (packed && rank == root) {
+		ret = copyTyped(packed, size * bytes, MPI_BYTE, rbuf, size * rcount, rtype);
+	}
+
+OUT:
+	free(packed);
+	return ret;
+}
+
+/*
+ * Every node gathers its blocks on its leader, or on the root in the
+ * node of the root, and the leaders send them to the root in one
+ * message each, which lands straight in rbuf through an indexed type.
+ */
+int
+gatherHierarchical(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0;
+	const Topology *topo = NULL;
+	char *tmp = NULL;
+	MPI_Request *requests = NULL;
+	MPI_Datatype *types = NULL;
+
+	ret = getTopology(comm, &topo);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (topo->nNodes == 1) {
+		return gatherShared(sbuf, scount, stype, rbuf, rcount, rtype, root, comm);
+	}
+	MPI_Comm_rank(comm, &rank);
+	if (rank == root) {
+		inPlaceBlock(&sbuf, &scount, &stype, rbuf, rcount, rtype, root);
+	}
+
+	MPI_Aint lb = 0, sextent = 0, rextent = 0;
+	MPI_Type_get_extent(stype, &lb, &sextent);
+
+	int rootNode = topo->nodeOf[root];
+	int nodeRoot = topo->node == rootNode ? topo->nodeRankOf[root] : 0;
+
+	if (topo->nodeRank == nodeRoot) {
+		tmp = allocTyped(topo->nodeSize * scount, stype);
+		if (!tmp) {
+			ret = MPI_ERR_NO_MEM;
+			goto OUT;
+		}
+	}
+	ret = gather(sbuf, scount, stype, tmp, scount, stype, nodeRoot, topo->nodeComm);
+	if (ret != MPI_SUCCESS || topo->nodeRank != nodeRoot) {
+		goto OUT;
+	}
+
+	if (rank != root) {
+		ret = MPI_Send(tmp, topo->nodeSize * scount, stype, root, GATHER_TAG, comm);
+		goto OUT;
+	}
+
+	requests = (MPI_Request *)malloc(topo->nNodes * sizeof(MPI_Request));
+	types = (MPI_Datatype *)malloc(topo->nNodes * sizeof(MPI_Datatype));
+	if (!requests || !types) {
+		ret = MPI_ERR_NO_MEM;
+		goto OUT;
+	}
+	for (int n = 0; n < topo->nNodes; n++) {
+		requests[n] = MPI_REQUEST_NULL;
+		types[n] = MPI_DATATYPE_NULL;
+		if (n != rootNode) {
+			nodeBlocks(topo, n, rcount, rtype, &types[n]);
+			MPI_Irecv(rbuf, 1, types[n], topo->members[topo->firstMember[n]], GATHER_TAG, comm, &requests[n]);
+		}
+	}
+
+	MPI_Type_get_extent(rtype, &lb, &rextent);
+	for (int i = 0; i < topo->nodeSize && ret == MPI_SUCCESS; i++) {
+		ret = copyTyped(tmp + (MPI_Aint)i * scount * sextent, scount, stype,
+		                (char *)rbuf + (MPI_Aint)topo->members[topo->firstMember[rootNode] + i] * rcount * rextent,
+		                rcount, rtype);
+	}
+
+	int waited = MPI_Waitall(topo->nNodes, requests, MPI_STATUSES_IGNORE);
+	ret = ret == MPI_SUCCESS ? waited : ret;
+
+	for (int n = 0; n < topo->nNodes; n++) {
+		if (types[n] != MPI_DATATYPE_NULL) {
+			MPI_Type_free(&types[n]);
+		}
+	}
+
+OUT:
+	free(types);
+	free(requests);
+	freeTyped(tmp, stype);
+	return ret;
+}
+
+#define REDUCE_TAG 3
+
+#define REDUCE_LONG_MSG 2048
+
+typedef int (*ReduceVariant)(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm);
+
+static const ReduceVariant reduceVariants[] = {
+	reduceLinear, reduceBinomial, reduceRabenseifner, reduceShared, reduceHierarchical,
+};
+
+/*
+ * A tree while the vector is short and its latency dominates, then
+ * Rabenseifner's once every rank can take a share of at least one
+ * element and the bandwidth at the root dominates.
+ */
+static int
+reduceMessages(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+	int size = 0, tsize = 0;
+	MPI_Comm_size(comm, &size);
+	MPI_Type_size(type, &tsize);
+
+	int pof2 = 1;
+	while (2 * pof2 <= size) {
+		pof2 *= 2;
+	}
+
+	if ((long)count * tsize < REDUCE_LONG_MSG || count < pof2) {
+		return reduceBinomial(sbuf, rbuf, count, type, op, root, comm);
+	}
+	return reduceRabenseifner(sbuf, rbuf, count, type, op, root, comm);
+}
+
+/*
+ * In two levels across nodes, through the shared window on a single
+ * one, otherwise by messages, unless tuned.
+ */
+int
+reduce(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+	int tsize = 0;
+	int ret = MPI_Type_size(type, &tsize);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+
+	int variant = decide(TunedReduce, comm, (long)count * tsize);
+	if (variant >= 0) {
+		return reduceVariants[variant](sbuf, rbuf, count, type, op, root, comm);
+	}
+	if (spansNodes(comm)) {
+		return reduceHierarchical(sbuf, rbuf, count, type, op, root, comm);
+	}
+	if (sharesMemory(comm) && findReduction(op, type)) {
+		return reduceShared(sbuf, rbuf, count, type, op, root, comm);
+	}
+	return reduceMessages(sbuf, rbuf, count, type, op, root, comm);
+}
+
+int
+reduceLinear(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0;
+	char *rtmp = NULL;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	Reduction reduction = findReduction(op, type);
+	if (!reduction) {
+		ret = MPI_ERR_OP;
+		goto OUT;
+	}
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	if (rank == root) {
+
+		MPI_Status status = {};
+		int size = 0;
+		
+		MPI_Comm_size(comm, &size);
+
+		int tsize = 0;
+		ret = MPI_Type_size(type, &tsize);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+
+		rtmp = calloc(count, tsize);
+		if (!rtmp && count > 0) {
+			ret = MPI_ERR_NO_MEM;
+			goto OUT;
+		}
+		ret = copyTyped(sbuf, count, type, rbuf, count, type);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+
+		for (int ranks = 0; ranks < size-1; ranks++) {
+			ret = MPI_Recv(rtmp, count, type, MPI_ANY_SOURCE, REDUCE_TAG, comm, &status);
+			if (ret != MPI_SUCCESS) {
+				goto OUT;
+			}
+			reduction(rbuf, rtmp, count);
+		}
+
+	} else {
+		ret = MPI_Send(sbuf, count, type, root, REDUCE_TAG, comm);
+	}
+
+OUT:
+	free(rtmp);
+	MPI_Barrier(comm);
+	return ret;
+}
+
+/*
+ * The gather tree of gatherBinomial with the vectors combined on the way:
+ * a rank folds in its children's partial results, smallest subtree first,
+ * and sends the sum on to its parent. The root accumulates in rbuf.
+ */
+int
+reduceBinomial(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	char *tmp = NULL;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	Reduction reduction = findReduction(op, type);
+	if (!reduction) {
+		ret = MPI_ERR_OP;
+		goto OUT;
+	}
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	MPI_Aint lb = 0, extent = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+
+	int vrank = (rank - root + size) % size;
+
+	/* leaves send sbuf as is, the others need the partial result and a receive buffer */
+	char *acc = sbuf;
+	if (vrank == 0 || !(vrank & 1)) {
+		tmp = (char *)malloc((vrank == 0 ? 1 : 2) * count * extent);
+		if (!tmp && count > 0) {
+			ret = MPI_ERR_NO_MEM;
+			goto OUT;
+		}
+		acc = vrank == 0 ? rbuf : tmp + count * extent;
+		ret = copyTyped(sbuf, count, type, acc, count, type);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+	for (int mask = 1; mask < size; mask <<= 1) {
+		if (vrank & mask) {
+			int parent = (rank - mask + size) % size;
+			ret = MPI_Send(acc, count, type, parent, REDUCE_TAG, comm);
+			break;
+		}
+		if (vrank + mask < size) {
+			int child = (rank + mask) % size;
+			ret = MPI_Recv(tmp, count, type, child, REDUCE_TAG, comm, MPI_STATUS_IGNORE);
+			if (ret != MPI_SUCCESS) {
+				goto OUT;
+			}
+			reduction(acc, tmp, count);
+		}
+	}
+
+OUT:
+	free(tmp);
+	return ret;
+}
+
+/*
+ * Rabenseifner: the ranks beyond the largest power of two pof2 first fold
+ * their vectors into a neighbour, then the pof2 remaining ones
+ * reduce-scatter by recursive halving, exchanging half of what is left
+ * at each step, so rank r ends up with block r of the result. A binomial
+ * gather then brings the blocks to the root, straight into rbuf. About
+ * 2 * n bytes are moved and n combined per rank, whatever P.
+ */
+int
+reduceRabenseifner(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	char *tmp = NULL;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	Reduction reduction = findReduction(op, type);
+	if (!reduction) {
+		ret = MPI_ERR_OP;
+		goto OUT;
+	}
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	MPI_Aint lb = 0, extent = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+
+	int vrank = (rank - root + size) % size;
+	int pof2 = 1;
+	while (2 * pof2 <= size) {
+		pof2 *= 2;
+	}
+	int rem = size - pof2;
+
+	tmp = (char *)malloc((vrank == 0 ? 1 : 2) * count * extent);
+	if (!tmp && count > 0) {
+		ret = MPI_ERR_NO_MEM;
+		goto OUT;
+	}
+	char *acc = vrank == 0 ? rbuf : tmp + count * extent;
+	ret = copyTyped(sbuf, count, type, acc, count, type);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	/* of the first 2 * rem ranks the odd ones hand over to the even ones and drop out */
+	int newrank = vrank < 2 * rem ? vrank / 2 : vrank - rem;
+	if (vrank < 2 * rem) {
+		if (vrank & 1) {
+			ret = MPI_Send(acc, count, type, (rank - 1 + size) % size, REDUCE_TAG, comm);
+			goto OUT;
+		}
+		ret = MPI_Recv(tmp, count, type, (rank + 1) % size, REDUCE_TAG, comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		reduction(acc, tmp, count);
+	}
+
+	#define REAL_RANK(r)  (((r) < rem ? 2 * (r) : (r) + rem) + root) % size
+	#define BLOCK(b)      ((b) * (count / pof2) + ((b) < count % pof2 ? (b) : count % pof2))
+	#define AT(buf, b)    ((char *)(buf) + BLOCK(b) * extent)
+
+	/* reduce-scatter, the blocks [first, last) are still ours */
+	int first = 0, last = pof2;
+	for (int mask = pof2 / 2; mask > 0; mask /= 2) {
+		int partner = REAL_RANK(newrank ^ mask);
+		int mid = first + mask;
+		int keep = newrank & mask ? mid : first, give = newrank & mask ? first : mid;
+
+		ret = MPI_Sendrecv(AT(acc, give), BLOCK(give + mask) - BLOCK(give), type, partner, REDUCE_TAG,
+		                   AT(tmp, keep), BLOCK(keep + mask) - BLOCK(keep), type, partner, REDUCE_TAG,
+		                   comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		reduction(AT(acc, keep), AT(tmp, keep), BLOCK(keep + mask) - BLOCK(keep));
+		first = keep;
+		last = keep + mask;
+	}
+
+	/* gather, newrank r holds the blocks [r, r + lowbit(r)) before sending them */
+	for (int mask = 1; mask < pof2; mask <<= 1) {
+		if (newrank & mask) {
+			ret = MPI_Send(AT(acc, first), BLOCK(last) - BLOCK(first), type, REAL_RANK(newrank - mask),
+			               REDUCE_TAG, comm);
+			break;
+		}
+		ret = MPI_Recv(AT(acc, last), BLOCK(last + mask) - BLOCK(last), type, REAL_RANK(newrank + mask),
+		               REDUCE_TAG, comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		last += mask;
+	}
+
+	#undef REAL_RANK
+	#undef BLOCK
+	#undef AT
+
+OUT:
+	free(tmp);
+	return ret;
+}
+
+/*
+ * Two steps per chunk: every rank copies its chunk into its slot, then
+ * combines slice r of all the slots into its own, so the P ranks share
+ * the arithmetic, and the root copies the slices out. Each vector is
+ * copied once and nothing goes through a message.
+ */
+int
+reduceShared(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0, tsize = 0;
+	Segment *segment = NULL;
+
+	Reduction reduction = findReduction(op, type);
+	if (!reduction) {
+		ret = MPI_ERR_OP;
+		goto OUT;
+	}
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	ret = getSegment(comm, &segment);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (!segment) {
+		return reduceBinomial(sbuf, rbuf, count, type, op, root, comm);
+	}
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	MPI_Type_size(type, &tsize);
+
+	int chunk = chunkBytes(segment) / tsize;
+
+	#define SLICE(r, n) ((long)(r) * (n) / size)
+
+	for (int first = 0; first < count; first += chunk) {
+		int n = count - first < chunk ? count - first : chunk;
+		int lo = SLICE(rank, n), hi = SLICE(rank + 1, n);
+
+		waitWritable(segment);
+		memcpy(chunkSlot(segment, rank), (char *)sbuf + (size_t)first * tsize, (size_t)n * tsize);
+		postStep(segment, 1);
+
+		for (int r = 0; r < size; r++) {
+			if (r != rank) {
+				waitStep(segment, r, 1);
+				reduction(chunkSlot(segment, rank) + (size_t)lo * tsize,
+				          chunkSlot(segment, r) + (size_t)lo * tsize, hi - lo);
+			}
+		}
+
+		/* the root posts last, once it has read every slice, so no slot is overwritten before */
+		if (rank == root) {
+			for (int r = 0; r < size; r++) {
+				if (r != root) {
+					waitStep(segment, r, 2);
+				}
+				memcpy((char *)rbuf + ((size_t)first + SLICE(r, n)) * tsize,
+				       chunkSlot(segment, r) + (size_t)SLICE(r, n) * tsize,
+				       (size_t)(SLICE(r + 1, n) - SLICE(r, n)) * tsize);
+			}
+		}
+		postStep(segment, 2);
+		nextChunk(segment, 2);
+	}
+
+	#undef SLICE
+
+OUT:
+	return ret;
+}
+
+/*
+ * Every node reduces on its leader, the leaders reduce on the leader of
+ * the node of the root, which hands the result to the root if it is
+ * another rank.
+ */
+int
+reduceHierarchical(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0;
+	const Topology *topo = NULL;
+	char *tmp = NULL;
+
+	ret = getTopology(comm, &topo);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (topo->nNodes == 1) {
+		return reduceShared(sbuf, rbuf, count, type, op, root, comm);
+	}
+	MPI_Comm_rank(comm, &rank);
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	MPI_Aint lb = 0, extent = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+
+	int rootNode = topo->nodeOf[root];
+	int handOver = topo->nodeRankOf[root] != 0;
+
+	/* the node's vector, then the result if the root is not the leader */
+	if (topo->nodeRank == 0) {
+		tmp = (char *)malloc((handOver && topo->node == rootNode ? 2 : 1) * count * extent);
+		if (!tmp && count > 0) {
+			ret = MPI_ERR_NO_MEM;
+			goto OUT;
+		}
+	}
+
+	ret = reduce(sbuf, tmp, count, type, op, 0, topo->nodeComm);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (topo->leaderComm != MPI_COMM_NULL) {
+		void *result = rank == root ? rbuf : tmp + count * extent;
+		ret = reduceMessages(tmp, result, count, type, op, rootNode, topo->leaderComm);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+	if (handOver && topo->node == rootNode) {
+		if (topo->nodeRank == 0) {
+			ret = MPI_Send(tmp + count * extent, count, type, topo->nodeRankOf[root], REDUCE_TAG, topo->nodeComm);
+		} else if (rank == root) {
+			ret = MPI_Recv(rbuf, count, type, 0, REDUCE_TAG, topo->nodeComm, MPI_STATUS_IGNORE);
+		}
+	}
+
+OUT:
+	free(tmp);
+	return ret;
+}
+
+#define SCATTER_TAG 4
+
+typedef int (*ScatterVariant)(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype,
+                              int root, MPI_Comm comm);
+
+static const ScatterVariant scatterVariants[] = {
+	scatterLinear, scatterBinomial, scatterShared,
+};
+
+/* through the shared window on a node, otherwise a tree, unless tuned */
+int
+scatter(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm)
+{
+	int rank = 0, rsize = 0;
+	MPI_Comm_rank(comm, &rank);
+	if (rank == root) {
+		inPlaceBlock(&rbuf, &rcount, &rtype, sbuf, scount, stype, root);
+	}
+	MPI_Type_size(rtype, &rsize);
+
+	int variant = decide(TunedScatter, comm, (long)rcount * rsize);
+	if (variant >= 0) {
+		return scatterVariants[variant](sbuf, scount, stype, rbuf, rcount, rtype, root, comm);
+	}
+	if (sharesMemory(comm)) {
+		return scatterShared(sbuf, scount, stype, rbuf, rcount, rtype, root, comm);
+	}
+	return scatterBinomial(sbuf, scount, stype, rbuf, rcount, rtype, root, comm);
+}
+
+int
+scatterLinear(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	if (rank == root) {
+		
+		int size = 0;
+		MPI_Comm_size(comm, &size);
+
+		MPI_Aint lb = 0, sextent = 0;
+		ret = MPI_Type_get_extent(stype, &lb, &sextent);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+
+		inPlaceBlock(&rbuf, &rcount, &rtype, sbuf, scount, stype, root);
+		ret = copyTyped((char *)sbuf + (MPI_Aint)root * scount * sextent, scount, stype, rbuf, rcount, rtype);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+
+		for (int rank = 0; rank < size; rank++) {
+			if (rank == root) {
+				continue;
+			}
+
+			MPI_Aint off = (MPI_Aint)rank * scount * sextent;
+			ret = MPI_Send((char *)sbuf + off, scount, stype, rank, SCATTER_TAG, comm);
+			if (ret != MPI_SUCCESS) {
+				goto OUT;
+			}
+		}
+
+	} else {
+
+		MPI_Status status = {};
+		ret = MPI_Recv(rbuf, rcount, rtype, root, SCATTER_TAG, comm, &status);
+	}
+
+OUT:
+	MPI_Barrier(comm);
+	return ret;
+}
+
+/*
+ * The gather tree the other way round: a rank receives the blocks of its
+ * whole subtree from its parent in one message and forwards each child
+ * the range of the child's subtree, largest first, so the root sends
+ * ceil(log2 P) messages instead of P - 1. Ranks are taken relative to
+ * the root, which sends straight from sbuf.
+ */
+int
+scatterBinomial(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	char *tmp = NULL;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	int vrank = (rank - root + size) % size;
+	int subtree = vrank == 0 ? size : vrank & -vrank;
+	if (subtree > size - vrank) {
+		subtree = size - vrank;
+	}
+	if (vrank == 0) {
+		inPlaceBlock(&rbuf, &rcount, &rtype, sbuf, scount, stype, root);
+	}
+
+	MPI_Aint lb = 0, sextent = 0, rextent = 0;
+	MPI_Type_get_extent(rtype, &lb, &rextent);
+
+	int mask = 1;
+	for (; mask < size; mask <<= 1) {
+		if (!(vrank & mask)) {
+			continue;
+		}
+
+		int parent = (rank - mask + size) % size;
+		if (subtree > 1) {
+			tmp = allocTyped(subtree * rcount, rtype);
+			if (!tmp) {
+				ret = MPI_ERR_NO_MEM;
+				goto OUT;
+			}
+			ret = MPI_Recv(tmp, subtree * rcount, rtype, parent, SCATTER_TAG, comm, MPI_STATUS_IGNORE);
+			if (ret == MPI_SUCCESS) {
+				ret = copyTyped(tmp, rcount, rtype, rbuf, rcount, rtype);
+			}
+		} else {
+			ret = MPI_Recv(rbuf, rcount, rtype, parent, SCATTER_TAG, comm, MPI_STATUS_IGNORE);
+		}
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		break;
+	}
+	if (vrank == 0) {
+		MPI_Type_get_extent(stype, &lb, &sextent);
+		ret = copyTyped((char *)sbuf + (MPI_Aint)root * scount * sextent, scount, stype, rbuf, rcount, rtype);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+	for (mask >>= 1; mask > 0; mask >>= 1) {
+		if (vrank + mask >= size) {
+			continue;
+		}
+
+		int child = (rank + mask) % size;
+		int blocks = size - vrank - mask < mask ? size - vrank - mask : mask;
+		if (vrank != 0) {
+			ret = MPI_Send(tmp + (MPI_Aint)mask * rcount * rextent, blocks * rcount, rtype, child, SCATTER_TAG, comm);
+		} else if (child + blocks <= size) {
+			ret = MPI_Send((char *)sbuf + (MPI_Aint)child * scount * sextent, blocks * scount, stype, child, SCATTER_TAG, comm);
+		} else {
+			MPI_Datatype wrapped;
+			ret = wrappedBlocks(child, blocks, size, scount, sextent, stype, &wrapped);
+			if (ret == MPI_SUCCESS) {
+				ret = MPI_Send(sbuf, 1, wrapped, child, SCATTER_TAG, comm);
+				MPI_Type_free(&wrapped);
+			}
+		}
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+OUT:
+	freeTyped(tmp, rtype);
+	return ret;
+}
+
+/* the root copies each chunk of every block into the slot of its rank, which copies it out */
+int
+scatterShared(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0, rsize = 0;
+	Segment *segment = NULL;
+	char *packed = NULL;
+
+	ret = getSegment(comm, &segment);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (!segment) {
+		return scatterBinomial(sbuf, scount, stype, rbuf, rcount, rtype, root, comm);
+	}
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	if (rank == root) {
+		inPlaceBlock(&rbuf, &rcount, &rtype, sbuf, scount, stype, root);
+	}
+	MPI_Type_size(rtype, &rsize);
+
+	/* the bytes of this rank's block, or of all the blocks on the root */
+	size_t bytes = (size_t)rcount * rsize;
+	char *data = NULL;
+	ret = rank == root ? sharedBytes(sbuf, size * scount, stype, 1, &data, &packed)
+	                   : sharedBytes(rbuf, rcount, rtype, 0, &data, &packed);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (rank == root) {
+		ret = copyTyped(data + root * bytes, bytes, MPI_BYTE, rbuf, rcount, rtype);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+	for (size_t off = 0; off < bytes; off += chunkBytes(segment)) {
+		size_t n = bytes - off < chunkBytes(segment) ? bytes - off : chunkBytes(segment);
+		if (rank == root) {
+			waitWritable(segment);
+			for (int r = 0; r < size; r++) {
+				if (r != root) {
+					memcpy(chunkSlot(segment, r), data + r * bytes + off, n);
+				}
+			}
+		} else {
+			waitStep(segment, root, 1);
+			memcpy(data + off, chunkSlot(segment, rank), n);
+		}
+		postStep(segment, 1);
+		nextChunk(segment, 1);
+	}
+	if (packed && rank != root) {
+		ret = copyTyped(packed, bytes, MPI_BYTE, rbuf, rcount, rtype);
+	}
+
+OUT:
+	free(packed);
+	return ret;
+}
+
+#define ALLGATHER_TAG 5
+
+#define ALLGATHER_LONG_MSG (64 * 1024)
+
+typedef int (*AllgatherVariant)(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype,
+                                MPI_Comm comm);
+
+static const AllgatherVariant allgatherVariants[] = {
+	allgatherRing, allgatherRecursiveDoubling, allgatherHierarchical,
+};
+
+/* doubling while the blocks are small, the ring once the bandwidth dominates */
+static int
+allgatherMessages(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm)
+{
+	int size = 0, rsize = 0;
+	MPI_Comm_size(comm, &size);
+	MPI_Type_size(rtype, &rsize);
+
+	if ((long)size * rcount * rsize < ALLGATHER_LONG_MSG) {
+		return allgatherRecursiveDoubling(sbuf, scount, stype, rbuf, rcount, rtype, comm);
+	}
+	return allgatherRing(sbuf, scount, stype, rbuf, rcount, rtype, comm);
+}
+
+/* in two levels across nodes, otherwise by messages, unless tuned */
+int
+allgather(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm)
+{
+	int rsize = 0;
+	int ret = MPI_Type_size(rtype, &rsize);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+
+	int variant = decide(TunedAllgather, comm, (long)rcount * rsize);
+	if (variant >= 0) {
+		return allgatherVariants[variant](sbuf, scount, stype, rbuf, rcount, rtype, comm);
+	}
+	if (spansNodes(comm)) {
+		return allgatherHierarchical(sbuf, scount, stype, rbuf, rcount, rtype, comm);
+	}
+	return allgatherMessages(sbuf, scount, stype, rbuf, rcount, rtype, comm);
+}
+
+/* at step i a rank passes on to the right the block it got from the left at step i - 1 */
+int
+allgatherRing(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	MPI_Aint lb = 0, extent = 0;
+	MPI_Type_get_extent(rtype, &lb, &extent);
+	inPlaceBlock(&sbuf, &scount, &stype, rbuf, rcount, rtype, rank);
+
+	#define BLOCK_BUF(r) ((char *)rbuf + (MPI_Aint)(r) * rcount * extent)
+
+	ret = copyTyped(sbuf, scount, stype, BLOCK_BUF(rank), rcount, rtype);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	int left = (rank - 1 + size) % size, right = (rank + 1) % size;
+	for (int i = 0; i < size - 1; i++) {
+		int out = (rank - i + size) % size, in = (rank - i - 1 + size) % size;
+		ret = MPI_Sendrecv(BLOCK_BUF(out), rcount, rtype, right, ALLGATHER_TAG,
+		                   BLOCK_BUF(in), rcount, rtype, left, ALLGATHER_TAG,
+		                   comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+	#undef BLOCK_BUF
+
+OUT:
+	return ret;
+}
+
+/*
+ * Ranks exchange everything they hold with the one differing in bit
+ * mask, doubling it each step. Beyond the largest power of two pof2 the
+ * odd ones of the first 2 * rem ranks hand their block to the even one
+ * below first and get the whole result back at the end; the blocks a
+ * rank holds stay contiguous in rbuf throughout, so all the data is
+ * received in place.
+ */
+int
+allgatherRecursiveDoubling(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	MPI_Aint lb = 0, extent = 0;
+	MPI_Type_get_extent(rtype, &lb, &extent);
+	inPlaceBlock(&sbuf, &scount, &stype, rbuf, rcount, rtype, rank);
+
+	int pof2 = 1;
+	while (2 * pof2 <= size) {
+		pof2 *= 2;
+	}
+	int rem = size - pof2;
+
+	/* the first block held by newrank r and the rank newrank r is */
+	#define FIRST(r)     ((r) < rem ? 2 * (r) : (r) + rem)
+	#define REAL_RANK(r) FIRST(r)
+	#define BLOCK_BUF(b) ((char *)rbuf + (MPI_Aint)(b) * rcount * extent)
+
+	ret = copyTyped(sbuf, scount, stype, BLOCK_BUF(rank), rcount, rtype);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	int newrank = rank < 2 * rem ? rank / 2 : rank - rem;
+	if (rank < 2 * rem) {
+		if (rank & 1) {
+			ret = MPI_Send(BLOCK_BUF(rank), rcount, rtype, rank - 1, ALLGATHER_TAG, comm);
+			if (ret == MPI_SUCCESS) {
+				ret = MPI_Recv(rbuf, size * rcount, rtype, rank - 1, ALLGATHER_TAG, comm, MPI_STATUS_IGNORE);
+			}
+			goto OUT;
+		}
+		ret = MPI_Recv(BLOCK_BUF(rank + 1), rcount, rtype, rank + 1, ALLGATHER_TAG, comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+	for (int mask = 1; mask < pof2; mask <<= 1) {
+		int mine = newrank & ~(mask - 1), theirs = mine ^ mask;
+		ret = MPI_Sendrecv(BLOCK_BUF(FIRST(mine)), (FIRST(mine + mask) - FIRST(mine)) * rcount, rtype,
+		                   REAL_RANK(newrank ^ mask), ALLGATHER_TAG,
+		                   BLOCK_BUF(FIRST(theirs)), (FIRST(theirs + mask) - FIRST(theirs)) * rcount, rtype,
+		                   REAL_RANK(newrank ^ mask), ALLGATHER_TAG, comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+	if (rank < 2 * rem) {
+		ret = MPI_Send(rbuf, size * rcount, rtype, rank + 1, ALLGATHER_TAG, comm);
+	}
+
+	#undef FIRST
+	#undef REAL_RANK
+	#undef BLOCK_BUF
+
+OUT:
+	return ret;
+}
+
+/*
+ * Every node gathers its blocks on its leader, the leaders pass the
+ * blocks of each node round a ring, straight into rbuf through indexed
+ * types, and every leader broadcasts the whole of rbuf within its node.
+ */
+int
+allgatherHierarchical(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	const Topology *topo = NULL;
+	char *tmp = NULL;
+
+	ret = getTopology(comm, &topo);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (topo->nNodes == 1) {
+		return allgatherMessages(sbuf, scount, stype, rbuf, rcount, rtype, comm);
+	}
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	inPlaceBlock(&sbuf, &scount, &stype, rbuf, rcount, rtype, rank);
+
+	MPI_Aint lb = 0, sextent = 0, rextent = 0;
+	MPI_Type_get_extent(stype, &lb, &sextent);
+	MPI_Type_get_extent(rtype, &lb, &rextent);
+
+	if (topo->nodeRank == 0) {
+		tmp = allocTyped(topo->nodeSize * scount, stype);
+		if (!tmp) {
+			ret = MPI_ERR_NO_MEM;
+			goto OUT;
+		}
+	}
+	ret = gather(sbuf, scount, stype, tmp, scount, stype, 0, topo->nodeComm);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	if (topo->leaderComm != MPI_COMM_NULL) {
+		for (int i = 0; i < topo->nodeSize && ret == MPI_SUCCESS; i++) {
+			ret = copyTyped(tmp + (MPI_Aint)i * scount * sextent, scount, stype,
+			                (char *)rbuf + (MPI_Aint)topo->members[topo->firstMember[topo->node] + i] * rcount * rextent,
+			                rcount, rtype);
+		}
+
+		int left = (topo->node - 1 + topo->nNodes) % topo->nNodes, right = (topo->node + 1) % topo->nNodes;
+		for (int i = 0; i < topo->nNodes - 1 && ret == MPI_SUCCESS; i++) {
+			int out = (topo->node - i + topo->nNodes) % topo->nNodes,
+			    in = (topo->node - i - 1 + topo->nNodes) % topo->nNodes;
+			MPI_Datatype outBlocks, inBlocks;
+
+			nodeBlocks(topo, out, rcount, rtype, &outBlocks);
+			nodeBlocks(topo, in, rcount, rtype, &inBlocks);
+			ret = MPI_Sendrecv(rbuf, 1, outBlocks, right, ALLGATHER_TAG, rbuf, 1, inBlocks, left, ALLGATHER_TAG,
+			                   topo->leaderComm, MPI_STATUS_IGNORE);
+			MPI_Type_free(&outBlocks);
+			MPI_Type_free(&inBlocks);
+		}
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+	ret = bcast(rbuf, size * rcount, rtype, 0, topo->nodeComm);
+
+OUT:
+	freeTyped(tmp, stype);
+	return ret;
+}
+
+#define ALLREDUCE_TAG 6
+
+#define ALLREDUCE_LONG_MSG 2048
+
+typedef int (*AllreduceVariant)(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm);
+
+static const AllreduceVariant allreduceVariants[] = {
+	allreduceRing, allreduceRecursiveDoubling, allreduceHierarchical,
+};
+
+/* the same split as reduce: doubling for short vectors, the ring for long ones */
+static int
+allreduceMessages(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+	int size = 0, tsize = 0;
+	MPI_Comm_size(comm, &size);
+	MPI_Type_size(type, &tsize);
+
+	if ((long)count * tsize < ALLREDUCE_LONG_MSG || count < size) {
+		return allreduceRecursiveDoubling(sbuf, rbuf, count, type, op, comm);
+	}
+	return allreduceRing(sbuf, rbuf, count, type, op, comm);
+}
+
+/* in two levels across nodes, otherwise by messages, unless tuned */
+int
+allreduce(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+	int tsize = 0;
+	int ret = MPI_Type_size(type, &tsize);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+
+	int variant = decide(TunedAllreduce, comm, (long)count * tsize);
+	if (variant >= 0) {
+		return allreduceVariants[variant](sbuf, rbuf, count, type, op, comm);
+	}
+	if (spansNodes(comm)) {
+		return allreduceHierarchical(sbuf, rbuf, count, type, op, comm);
+	}
+	return allreduceMessages(sbuf, rbuf, count, type, op, comm);
+}
+
+/*
+ * A ring reduce-scatter, after which rank r holds block r + 1 of the
+ * result, then a ring allgather of the blocks: 2 * (P - 1) steps moving
+ * 2 * n * (P - 1) / P bytes per rank, which no algorithm beats.
+ */
+int
+allreduceRing(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	char *tmp = NULL;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	Reduction reduction = findReduction(op, type);
+	if (!reduction) {
+		ret = MPI_ERR_OP;
+		goto OUT;
+	}
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	MPI_Aint lb = 0, extent = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+
+	ret = copyTyped(sbuf, count, type, rbuf, count, type);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	#define BLOCK(b)  ((b) * (count / size) + ((b) < count % size ? (b) : count % size))
+	#define COUNT(b)  (BLOCK((b) + 1) - BLOCK(b))
+	#define AT(b)     ((char *)rbuf + BLOCK(b) * extent)
+
+	tmp = (char *)malloc((count / size + 1) * extent);
+	if (!tmp) {
+		ret = MPI_ERR_NO_MEM;
+		goto OUT;
+	}
+
+	int left = (rank - 1 + size) % size, right = (rank + 1) % size;
+	for (int i = 0; i < size - 1; i++) {
+		int out = (rank - i + size) % size, in = (rank - i - 1 + size) % size;
+		ret = MPI_Sendrecv(AT(out), COUNT(out), type, right, ALLREDUCE_TAG,
+		                   tmp, COUNT(in), type, left, ALLREDUCE_TAG, comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		reduction(AT(in), tmp, COUNT(in));
+	}
+
+	for (int i = 0; i < size - 1; i++) {
+		int out = (rank + 1 - i + size) % size, in = (rank - i + size) % size;
+		ret = MPI_Sendrecv(AT(out), COUNT(out), type, right, ALLREDUCE_TAG,
+		                   AT(in), COUNT(in), type, left, ALLREDUCE_TAG, comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+	#undef BLOCK
+	#undef COUNT
+	#undef AT
+
+OUT:
+	free(tmp);
+	return ret;
+}
+
+/*
+ * Ranks exchange their whole partial result with the one differing in
+ * bit mask and combine, log2 P steps of n bytes. As in the allgather the
+ * ranks beyond the largest power of two fold into a neighbour first and
+ * get the result back at the end.
+ */
+int
+allreduceRecursiveDoubling(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	char *tmp = NULL;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	Reduction reduction = findReduction(op, type);
+	if (!reduction) {
+		ret = MPI_ERR_OP;
+		goto OUT;
+	}
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	MPI_Aint lb = 0, extent = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+
+	int pof2 = 1;
+	while (2 * pof2 <= size) {
+		pof2 *= 2;
+	}
+	int rem = size - pof2;
+
+	ret = copyTyped(sbuf, count, type, rbuf, count, type);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	tmp = (char *)malloc(count * extent);
+	if (!tmp && count > 0) {
+		ret = MPI_ERR_NO_MEM;
+		goto OUT;
+	}
+
+	int newrank = rank < 2 * rem ? rank / 2 : rank - rem;
+	if (rank < 2 * rem) {
+		if (rank & 1) {
+			ret = MPI_Send(rbuf, count, type, rank - 1, ALLREDUCE_TAG, comm);
+			if (ret == MPI_SUCCESS) {
+				ret = MPI_Recv(rbuf, count, type, rank - 1, ALLREDUCE_TAG, comm, MPI_STATUS_IGNORE);
+			}
+			goto OUT;
+		}
+		ret = MPI_Recv(tmp, count, type, rank + 1, ALLREDUCE_TAG, comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		reduction(rbuf, tmp, count);
+	}
+
+	for (int mask = 1; mask < pof2; mask <<= 1) {
+		int partner = newrank ^ mask;
+		partner = partner < rem ? 2 * partner : partner + rem;
+		ret = MPI_Sendrecv(rbuf, count, type, partner, ALLREDUCE_TAG,
+		                   tmp, count, type, partner, ALLREDUCE_TAG, comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		reduction(rbuf, tmp, count);
+	}
+
+	if (rank < 2 * rem) {
+		ret = MPI_Send(rbuf, count, type, rank + 1, ALLREDUCE_TAG, comm);
+	}
+
+OUT:
+	free(tmp);
+	return ret;
+}
+
+/* every node reduces on its leader, the leaders allreduce and broadcast the result within their node */
+int
+allreduceHierarchical(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	const Topology *topo = NULL;
+	char *tmp = NULL;
+
+	ret = getTopology(comm, &topo);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (topo->nNodes == 1) {
+		return allreduceMessages(sbuf, rbuf, count, type, op, comm);
+	}
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	MPI_Aint lb = 0, extent = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+
+	if (topo->nodeRank == 0) {
+		tmp = (char *)malloc(count * extent);
+		if (!tmp && count > 0) {
+			ret = MPI_ERR_NO_MEM;
+			goto OUT;
+		}
+	}
+
+	ret = reduce(sbuf, tmp, count, type, op, 0, topo->nodeComm);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	if (topo->leaderComm != MPI_COMM_NULL) {
+		ret = allreduceMessages(tmp, rbuf, count, type, op, topo->leaderComm);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+	ret = bcast(rbuf, count, type, 0, topo->nodeComm);
+
+OUT:
+	free(tmp);
+	return ret;
+}
+
+#define ALLTOALL_TAG 7
+
+#define ALLTOALL_SHORT_MSG 256
+
+static const AllgatherVariant alltoallVariants[] = {
+	alltoallBruck, alltoallPairwise,
+};
+
+/* Bruck's log2 P rounds while the blocks are small, P - 1 direct exchanges otherwise, unless tuned */
+int
+alltoall(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm)
+{
+	int rsize = 0;
+	int ret = MPI_Type_size(rtype, &rsize);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+
+	/* the receive side, as the send one is not given with MPI_IN_PLACE */
+	int variant = decide(TunedAlltoall, comm, (long)rcount * rsize);
+	if (variant >= 0) {
+		return alltoallVariants[variant](sbuf, scount, stype, rbuf, rcount, rtype, comm);
+	}
+	if ((long)rcount * rsize < ALLTOALL_SHORT_MSG) {
+		return alltoallBruck(sbuf, scount, stype, rbuf, rcount, rtype, comm);
+	}
+	return alltoallPairwise(sbuf, scount, stype, rbuf, rcount, rtype, comm);
+}
+
+/*
+ * Bruck: the blocks are rotated so block i is the one for rank + i, then
+ * in round k every rank sends the blocks whose index has bit k set to
+ * rank + 2^k, packed in one message, and puts the ones from rank - 2^k
+ * in their place. Block i has then travelled i ranks, and the rotation
+ * is undone into rbuf. log2 P messages per rank, each block sent up to
+ * log2 P times, which pays off while the blocks are small. The blocks
+ * are packed from sbuf before anything lands in rbuf, so MPI_IN_PLACE
+ * needs nothing more.
+ */
+int
+alltoallBruck(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	char *tmp = NULL;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+		scount = rcount;
+		stype = rtype;
+	}
+
+	MPI_Aint lb = 0, sextent = 0, rextent = 0;
+	int block = 0;
+	MPI_Type_get_extent(stype, &lb, &sextent);
+	MPI_Type_get_extent(rtype, &lb, &rextent);
+	MPI_Type_size(stype, &block);
+	block *= scount;
+
+	/* the rotated blocks, then the packed ones going out and coming in */
+	int maxPacked = (size + 1) / 2;
+	tmp = (char *)malloc(((size_t)size + 2 * maxPacked) * block);
+	if (!tmp && block > 0) {
+		ret = MPI_ERR_NO_MEM;
+		goto OUT;
+	}
+	char *out = tmp + (size_t)size * block, *in = out + (size_t)maxPacked * block;
+
+	for (int i = 0; i < size && ret == MPI_SUCCESS; i++) {
+		ret = copyTyped((char *)sbuf + (MPI_Aint)((rank + i) % size) * scount * sextent, scount, stype,
+		                tmp + (size_t)i * block, block, MPI_BYTE);
+	}
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	for (int k = 1; k < size; k <<= 1) {
+		int packed = 0;
+		for (int i = k; i < size; i++) {
+			if (i & k) {
+				memcpy(out + (size_t)packed++ * block, tmp + (size_t)i * block, block);
+			}
+		}
+
+		ret = MPI_Sendrecv(out, packed * block, MPI_BYTE, (rank + k) % size, ALLTOALL_TAG,
+		                   in, packed * block, MPI_BYTE, (rank - k + size) % size, ALLTOALL_TAG,
+		                   comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+
+		packed = 0;
+		for (int i = k; i < size; i++) {
+			if (i & k) {
+				memcpy(tmp + (size_t)i * block, in + (size_t)packed++ * block, block);
+			}
+		}
+	}
+
+	for (int i = 0; i < size && ret == MPI_SUCCESS; i++) {
+		ret = copyTyped(tmp + (size_t)i * block, block, MPI_BYTE,
+		                (char *)rbuf + (MPI_Aint)((rank - i + size) % size) * rcount * rextent, rcount, rtype);
+	}
+
+OUT:
+	free(tmp);
+	return ret;
+}
+
+/*
+ * At step i every rank sends to rank + i and receives from rank - i,
+ * straight between the buffers. With MPI_IN_PLACE the peer of step i is
+ * i - rank instead, whose peer is the rank in turn, so the two swap
+ * their blocks in place.
+ */
+int
+alltoallPairwise(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	MPI_Aint lb = 0, sextent = 0, rextent = 0;
+	MPI_Type_get_extent(rtype, &lb, &rextent);
+
+	if (sbuf == MPI_IN_PLACE) {
+		for (int i = 0; i < size; i++) {
+			int peer = (i - rank + size) % size;
+			if (peer != rank) {
+				ret = MPI_Sendrecv_replace((char *)rbuf + (MPI_Aint)peer * rcount * rextent, rcount, rtype,
+				                           peer, ALLTOALL_TAG, peer, ALLTOALL_TAG, comm, MPI_STATUS_IGNORE);
+				if (ret != MPI_SUCCESS) {
+					goto OUT;
+				}
+			}
+		}
+		goto OUT;
+	}
+
+	MPI_Type_get_extent(stype, &lb, &sextent);
+	for (int i = 0; i < size; i++) {
+		int to = (rank + i) % size, from = (rank - i + size) % size;
+		ret = MPI_Sendrecv((char *)sbuf + (MPI_Aint)to * scount * sextent, scount, stype, to, ALLTOALL_TAG,
+		                   (char *)rbuf + (MPI_Aint)from * rcount * rextent, rcount, rtype, from, ALLTOALL_TAG,
+		                   comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+OUT:
+	return ret;
+}
+
+/*
+ * The pairwise exchange with the counts and displacements, in elements,
+ * of each peer, swapping the blocks in place as alltoallPairwise with
+ * MPI_IN_PLACE. Bruck would need the counts of every block it forwards.
+ */
+int
+alltoallv(void *sbuf, const int *scounts, const int *sdispls, MPI_Datatype stype,
+          void *rbuf, const int *rcounts, const int *rdispls, MPI_Datatype rtype, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	MPI_Aint lb = 0, sextent = 0, rextent = 0;
+	MPI_Type_get_extent(rtype, &lb, &rextent);
+
+	if (sbuf == MPI_IN_PLACE) {
+		for (int i = 0; i < size; i++) {
+			int peer = (i - rank + size) % size;
+			if (peer != rank) {
+				ret = MPI_Sendrecv_replace((char *)rbuf + rdispls[peer] * rextent, rcounts[peer], rtype,
+				                           peer, ALLTOALL_TAG, peer, ALLTOALL_TAG, comm, MPI_STATUS_IGNORE);
+				if (ret != MPI_SUCCESS) {
+					goto OUT;
+				}
+			}
+		}
+		goto OUT;
+	}
+
+	MPI_Type_get_extent(stype, &lb, &sextent);
+	for (int i = 0; i < size; i++) {
+		int to = (rank + i) % size, from = (rank - i + size) % size;
+		ret = MPI_Sendrecv((char *)sbuf + sdispls[to] * sextent, scounts[to], stype, to, ALLTOALL_TAG,
+		                   (char *)rbuf + rdispls[from] * rextent, rcounts[from], rtype, from, ALLTOALL_TAG,
+		                   comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+	}
+
+OUT:
+	return ret;
+}
+
+#define REDUCE_SCATTER_TAG 8
+
+/*
+ * Recursive halving: a rank sends the half of what it still holds that
+ * the one differing in bit mask is responsible for, and combines the
+ * other half with what it receives, so it ends up with its own block
+ * after log2 P steps moving n * (P - 1) / P bytes. As in the allgather
+ * the ranks beyond the largest power of two fold into a neighbour
+ * first, which then takes care of both their blocks.
+ */
+int
+reduceScatterBlock(void *sbuf, void *rbuf, int rcount, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	char *tmp = NULL;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	Reduction reduction = findReduction(op, type);
+	if (!reduction) {
+		ret = MPI_ERR_OP;
+		goto OUT;
+	}
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	MPI_Aint lb = 0, extent = 0;
+	int tsize = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+	MPI_Type_size(type, &tsize);
+
+	int pof2 = 1;
+	while (2 * pof2 <= size) {
+		pof2 *= 2;
+	}
+	int rem = size - pof2;
+
+	/* the partial results of every block and the halves coming in */
+	int count = size * rcount;
+	tmp = (char *)malloc(2 * (size_t)count * extent);
+	if (!tmp && count > 0) {
+		ret = MPI_ERR_NO_MEM;
+		goto OUT;
+	}
+	char *acc = tmp + (size_t)count * extent;
+	ret = copyTyped(sbuf, count, type, acc, count, type);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	/* the first block newrank r is responsible for and the rank newrank r is */
+	#define FIRST(r)     ((r) < rem ? 2 * (r) : (r) + rem)
+	#define REAL_RANK(r) FIRST(r)
+	#define AT(buf, b)   ((char *)(buf) + (MPI_Aint)(b) * rcount * extent)
+
+	int newrank = rank < 2 * rem ? rank / 2 : rank - rem;
+	if (rank < 2 * rem) {
+		if (rank & 1) {
+			ret = MPI_Send(acc, count, type, rank - 1, REDUCE_SCATTER_TAG, comm);
+			if (ret == MPI_SUCCESS) {
+				ret = MPI_Recv(rbuf, rcount, type, rank - 1, REDUCE_SCATTER_TAG, comm, MPI_STATUS_IGNORE);
+			}
+			goto OUT;
+		}
+		ret = MPI_Recv(tmp, count, type, rank + 1, REDUCE_SCATTER_TAG, comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		reduction(acc, tmp, count);
+	}
+
+	/* the newranks [first, first + 2 * mask) are still ours */
+	int first = 0;
+	for (int mask = pof2 / 2; mask > 0; mask /= 2) {
+		int keep = newrank & mask ? first + mask : first, give = newrank & mask ? first : first + mask;
+		int keepCount = (FIRST(keep + mask) - FIRST(keep)) * rcount,
+		    giveCount = (FIRST(give + mask) - FIRST(give)) * rcount;
+
+		ret = MPI_Sendrecv(AT(acc, FIRST(give)), giveCount, type, REAL_RANK(newrank ^ mask), REDUCE_SCATTER_TAG,
+		                   AT(tmp, FIRST(keep)), keepCount, type, REAL_RANK(newrank ^ mask), REDUCE_SCATTER_TAG,
+		                   comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		reduction(AT(acc, FIRST(keep)), AT(tmp, FIRST(keep)), keepCount);
+		first = keep;
+	}
+
+	memcpy(rbuf, AT(acc, rank), rcount * tsize);
+	if (rank < 2 * rem) {
+		ret = MPI_Send(AT(acc, rank + 1), rcount, type, rank + 1, REDUCE_SCATTER_TAG, comm);
+	}
+
+	#undef FIRST
+	#undef REAL_RANK
+	#undef AT
+
+OUT:
+	free(tmp);
+	return ret;
+}
+
+#define SCAN_TAG 9
+
+/*
+ * Hillis-Steele: at step k every rank passes what it has so far to
+ * rank + k and folds in the one of rank - k, which then covers the 2k
+ * ranks up to it. ceil(log2 P) steps.
+ */
+int
+scan(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	char *tmp = NULL;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	Reduction reduction = findReduction(op, type);
+	if (!reduction) {
+		ret = MPI_ERR_OP;
+		goto OUT;
+	}
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	MPI_Aint lb = 0, extent = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+
+	ret = copyTyped(sbuf, count, type, rbuf, count, type);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	tmp = (char *)malloc(count * extent);
+	if (!tmp && count > 0) {
+		ret = MPI_ERR_NO_MEM;
+		goto OUT;
+	}
+
+	for (int k = 1; k < size; k <<= 1) {
+		int to = rank + k < size ? rank + k : MPI_PROC_NULL, from = rank - k >= 0 ? rank - k : MPI_PROC_NULL;
+		ret = MPI_Sendrecv(rbuf, count, type, to, SCAN_TAG, tmp, count, type, from, SCAN_TAG,
+		                   comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		if (from != MPI_PROC_NULL) {
+			reduction(rbuf, tmp, count);
+		}
+	}
+
+OUT:
+	free(tmp);
+	return ret;
+}
+
+/*
+ * The scan with the inclusive partial result kept aside: what comes in
+ * from below goes into both, so rbuf ends up without the rank's own
+ * vector. rbuf is left untouched on rank 0, as in MPI_Exscan.
+ */
+int
+exscan(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+	int ret = MPI_SUCCESS;
+	int rank = 0, size = 0;
+	char *tmp = NULL;
+
+	ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+	MPI_Comm_size(comm, &size);
+
+	Reduction reduction = findReduction(op, type);
+	if (!reduction) {
+		ret = MPI_ERR_OP;
+		goto OUT;
+	}
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	MPI_Aint lb = 0, extent = 0;
+	int tsize = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+	MPI_Type_size(type, &tsize);
+
+	tmp = (char *)malloc(2 * (size_t)count * extent);
+	if (!tmp && count > 0) {
+		ret = MPI_ERR_NO_MEM;
+		goto OUT;
+	}
+	char *partial = tmp + (size_t)count * extent;
+	ret = copyTyped(sbuf, count, type, partial, count, type);
+	if (ret != MPI_SUCCESS) {
+		goto OUT;
+	}
+
+	for (int k = 1; k < size; k <<= 1) {
+		int to = rank + k < size ? rank + k : MPI_PROC_NULL, from = rank - k >= 0 ? rank - k : MPI_PROC_NULL;
+		ret = MPI_Sendrecv(partial, count, type, to, SCAN_TAG, tmp, count, type, from, SCAN_TAG,
+		                   comm, MPI_STATUS_IGNORE);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		if (from != MPI_PROC_NULL) {
+			reduction(partial, tmp, count);
+			if (k == 1) {
+				memcpy(rbuf, tmp, count * tsize);
+			} else {
+				reduction(rbuf, tmp, count);
+			}
+		}
+	}
+
+OUT:
+	free(tmp);
+	return ret;
+}
+
+/*
+ * The non-blocking collectives build the schedule of the binomial tree
+ * of their blocking counterparts, on tags of their own so that they may
+ * be in flight alongside blocking ones on the same comm.
+ */
+#define IBCAST_TAG   21
+#define IGATHER_TAG  22
+#define IREDUCE_TAG  23
+#define ISCATTER_TAG 24
+
+/* and the persistent ones, which may be started alongside the rest */
+#define PBCAST_TAG   25
+#define PREDUCE_TAG  26
+
+static int
+startOrFail(Schedule *schedule, Schedule **request)
+{
+	int ret = startSchedule(schedule);
+	*request = ret == MPI_SUCCESS ? schedule : NULL;
+	return ret;
+}
+
+static void
+buildBcast(Schedule *schedule, void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, int tag)
+{
+	int rank = 0, size = 0;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+
+	int vrank = (rank - root + size) % size;
+	int mask = 1;
+	for (; mask < size; mask <<= 1) {
+		if (vrank & mask) {
+			addRecv(schedule, buf, count, type, (rank - mask + size) % size, tag, comm);
+			addRound(schedule);
+			break;
+		}
+	}
+	for (mask >>= 1; mask > 0; mask >>= 1) {
+		if (vrank + mask < size) {
+			addSend(schedule, buf, count, type, (rank + mask) % size, tag, comm);
+		}
+	}
+}
+
+int
+ibcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, Schedule **request)
+{
+	int size = 0;
+	int ret = MPI_Comm_size(comm, &size);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+
+	Schedule *schedule = newSchedule();
+	if (!schedule) {
+		return MPI_ERR_NO_MEM;
+	}
+	buildBcast(schedule, buf, count, type, root, comm, IBCAST_TAG);
+
+	return startOrFail(schedule, request);
+}
+
+int
+igather(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root,
+        MPI_Comm comm, Schedule **request)
+{
+	int rank = 0, size = 0;
+	int ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+	MPI_Comm_size(comm, &size);
+
+	Schedule *schedule = newSchedule();
+	if (!schedule) {
+		return MPI_ERR_NO_MEM;
+	}
+
+	int vrank = (rank - root + size) % size;
+	int subtree = vrank == 0 ? size : vrank & -vrank;
+	if (subtree > size - vrank) {
+		subtree = size - vrank;
+	}
+	if (vrank == 0) {
+		inPlaceBlock(&sbuf, &scount, &stype, rbuf, rcount, rtype, root);
+	}
+
+	MPI_Aint lb = 0, sextent = 0, rextent = 0;
+	MPI_Type_get_extent(stype, &lb, &sextent);
+
+	/* the subtree's blocks in relative rank order below the root */
+	char *tmp = NULL;
+	if (vrank == 0) {
+		MPI_Type_get_extent(rtype, &lb, &rextent);
+		addCopy(schedule, sbuf, scount, stype, (char *)rbuf + (MPI_Aint)root * rcount * rextent, rcount, rtype);
+	} else if (subtree > 1) {
+		tmp = (char *)scheduleBuffer(schedule, typedBytes(subtree * scount, stype, &lb));
+		if (tmp) {
+			tmp -= lb;
+			addCopy(schedule, sbuf, scount, stype, tmp, scount, stype);
+		}
+	}
+
+	int mask = 1;
+	for (; mask < size && !(vrank & mask); mask <<= 1) {
+		if (vrank + mask >= size) {
+			continue;
+		}
+
+		int child = (rank + mask) % size;
+		int blocks = size - vrank - mask < mask ? size - vrank - mask : mask;
+		if (vrank != 0) {
+			if (tmp) {
+				addRecv(schedule, tmp + (MPI_Aint)mask * scount * sextent, blocks * scount, stype, child, IGATHER_TAG, comm);
+			}
+		} else if (child + blocks <= size) {
+			addRecv(schedule, (char *)rbuf + (MPI_Aint)child * rcount * rextent, blocks * rcount, rtype, child,
+			        IGATHER_TAG, comm);
+		} else {
+			MPI_Datatype wrapped;
+			wrappedBlocks(child, blocks, size, rcount, rextent, rtype, &wrapped);
+			scheduleType(schedule, wrapped);
+			addRecv(schedule, rbuf, 1, wrapped, child, IGATHER_TAG, comm);
+		}
+	}
+	if (vrank != 0) {
+		addRound(schedule);
+		addSend(schedule, tmp ? tmp : sbuf, subtree * scount, stype, (rank - mask + size) % size, IGATHER_TAG, comm);
+	}
+
+	return startOrFail(schedule, request);
+}
+
+/* the children's vectors land in buffers of their own so they are all received at once */
+static void
+buildReduce(Schedule *schedule, void *sbuf, void *rbuf, int count, MPI_Datatype type, Reduction reduction,
+            int root, MPI_Comm comm, int tag)
+{
+	int rank = 0, size = 0;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+
+	if (sbuf == MPI_IN_PLACE) {
+		sbuf = rbuf;
+	}
+
+	MPI_Aint lb = 0, extent = 0;
+	MPI_Type_get_extent(type, &lb, &extent);
+
+	int vrank = (rank - root + size) % size;
+
+	char *children[32];
+	int nChildren = 0;
+	int mask = 1;
+	for (; mask < size && !(vrank & mask); mask <<= 1) {
+		if (vrank + mask < size) {
+			children[nChildren] = (char *)scheduleBuffer(schedule, count * extent);
+			if (children[nChildren]) {
+				addRecv(schedule, children[nChildren++], count, type, (rank + mask) % size, tag, comm);
+			}
+		}
+	}
+
+	/* leaves send sbuf as is */
+	char *acc = sbuf;
+	if (vrank == 0 || nChildren > 0) {
+		acc = vrank == 0 ? rbuf : (char *)scheduleBuffer(schedule, count * extent);
+		if (acc) {
+			addCopy(schedule, sbuf, count, type, acc, count, type);
+		}
+	}
+	if (acc) {
+		addRound(schedule);
+		for (int c = 0; c < nChildren; c++) {
+			addReduction(schedule, reduction, acc, children[c], count);
+		}
+		if (vrank != 0) {
+			addSend(schedule, acc, count, type, (rank - mask + size) % size, tag, comm);
+		}
+	}
+}
+
+int
+ireduce(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm,
+        Schedule **request)
+{
+	int size = 0;
+	int ret = MPI_Comm_size(comm, &size);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+
+	Reduction reduction = findReduction(op, type);
+	if (!reduction) {
+		return MPI_ERR_OP;
+	}
+
+	Schedule *schedule = newSchedule();
+	if (!schedule) {
+		return MPI_ERR_NO_MEM;
+	}
+	buildReduce(schedule, sbuf, rbuf, count, type, reduction, root, comm, IREDUCE_TAG);
+
+	return startOrFail(schedule, request);
+}
+
+/*
+ * The gather tree the other way round: a rank receives the blocks of its
+ * whole subtree from its parent and sends each child the ones of its own
+ * subtree, largest first. The root sends straight from sbuf.
+ */
+int
+iscatter(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root,
+         MPI_Comm comm, Schedule **request)
+{
+	int rank = 0, size = 0;
+	int ret = MPI_Comm_rank(comm, &rank);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+	MPI_Comm_size(comm, &size);
+
+	Schedule *schedule = newSchedule();
+	if (!schedule) {
+		return MPI_ERR_NO_MEM;
+	}
+
+	int vrank = (rank - root + size) % size;
+	int subtree = vrank == 0 ? size : vrank & -vrank;
+	if (subtree > size - vrank) {
+		subtree = size - vrank;
+	}
+	if (vrank == 0) {
+		inPlaceBlock(&rbuf, &rcount, &rtype, sbuf, scount, stype, root);
+	}
+
+	MPI_Aint lb = 0, sextent = 0, rextent = 0;
+	MPI_Type_get_extent(rtype, &lb, &rextent);
+
+	char *tmp = NULL;
+	int mask = 1;
+	for (; mask < size; mask <<= 1) {
+		if (vrank & mask) {
+			int parent = (rank - mask + size) % size;
+			if (subtree > 1) {
+				tmp = (char *)scheduleBuffer(schedule, typedBytes(subtree * rcount, rtype, &lb));
+				if (tmp) {
+					tmp -= lb;
+					addRecv(schedule, tmp, subtree * rcount, rtype, parent, ISCATTER_TAG, comm);
+					addRound(schedule);
+					addCopy(schedule, tmp, rcount, rtype, rbuf, rcount, rtype);
+				}
+			} else {
+				addRecv(schedule, rbuf, rcount, rtype, parent, ISCATTER_TAG, comm);
+			}
+			break;
+		}
+	}
+	if (vrank == 0) {
+		MPI_Type_get_extent(stype, &lb, &sextent);
+		addCopy(schedule, (char *)sbuf + (MPI_Aint)root * scount * sextent, scount, stype, rbuf, rcount, rtype);
+	}
+
+	for (mask >>= 1; mask > 0; mask >>= 1) {
+		if (vrank + mask >= size) {
+			continue;
+		}
+
+		int child = (rank + mask) % size;
+		int blocks = size - vrank - mask < mask ? size - vrank - mask : mask;
+		if (vrank != 0) {
+			if (tmp) {
+				addSend(schedule, tmp + (MPI_Aint)mask * rcount * rextent, blocks * rcount, rtype, child, ISCATTER_TAG, comm);
+			}
+		} else if (child + blocks <= size) {
+			addSend(schedule, (char *)sbuf + (MPI_Aint)child * scount * sextent, blocks * scount, stype, child,
+			        ISCATTER_TAG, comm);
+		} else {
+			MPI_Datatype wrapped;
+			wrappedBlocks(child, blocks, size, scount, sextent, stype, &wrapped);
+			scheduleType(schedule, wrapped);
+			addSend(schedule, sbuf, 1, wrapped, child, ISCATTER_TAG, comm);
+		}
+	}
+
+	return startOrFail(schedule, request);
+}
+
+static int
+initOrFail(Schedule *schedule, Schedule **request)
+{
+	int ret = initSchedule(schedule);
+	*request = ret == MPI_SUCCESS ? schedule : NULL;
+	return ret;
+}
+
+int
+bcastInit(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, Schedule **request)
+{
+	int size = 0;
+	int ret = MPI_Comm_size(comm, &size);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+
+	Schedule *schedule = newPersistentSchedule();
+	if (!schedule) {
+		return MPI_ERR_NO_MEM;
+	}
+	buildBcast(schedule, buf, count, type, root, comm, PBCAST_TAG);
+
+	return initOrFail(schedule, request);
+}
+
+int
+reduceInit(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm,
+           Schedule **request)
+{
+	int size = 0;
+	int ret = MPI_Comm_size(comm, &size);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+
+	Reduction reduction = findReduction(op, type);
+	if (!reduction) {
+		return MPI_ERR_OP;
+	}
+
+	Schedule *schedule = newPersistentSchedule();
+	if (!schedule) {
+		return MPI_ERR_NO_MEM;
+	}
+	buildReduce(schedule, sbuf, rbuf, count, type, reduction, root, comm, PREDUCE_TAG);
+
+	return initOrFail(schedule, request);
+}
@@ -0,0 +1,224 @@
+#ifndef __COLLECTIVES_H__
+#define __COLLECTIVES_H__
+
+#include "schedule.h"
+#include <mpi.h>
+
+/*
+ * Buffers are laid out by the extents of their datatypes, as in MPI, so
+ * derived ones with gaps or resized bounds work too, and are sent and
+ * received as they are rather than packed first; only Bruck's blocks and
+ * the chunks through a shared window are packed, and only for types with
+ * gaps. The bcast variants split the buffer in elements, so every rank
+ * must give the same type. MPI_IN_PLACE is taken as in MPI everywhere it
+ * applies, on the root of the rooted collectives.
+ */
+
+/* segment size of bcast on long messages, in bytes */
+extern int bcastSegment;
+
+/*
+ * The *Hierarchical variants run within every node, then among a leader
+ * per node, so only the leaders communicate across nodes. Nodes are the
+ * ranks sharing memory, or groups of this many consecutive ranks of the
+ * comm if positive, to emulate several on one machine. Read on the first
+ * collective on a comm, whose split is kept until it is freed.
+ */
+extern int hierarchyRanksPerNode;
+
+#define MAX_VARIANTS 8
+
+/* an entry point that picks among variants, e.g. bcast runs bcastLinear for "linear" */
+typedef struct {
+	const char *name;
+	const char *variants[MAX_VARIANTS];
+} Tunable;
+
+extern const Tunable tunables[];
+extern const int nTunables;
+
+/*
+ * Reads a decision table, lines of "collective comm_size bytes variant"
+ * such as "bcast 8 65536 pipeline", and makes the entry points run the
+ * variant of the nearest comm size and the largest size up to the
+ * message's, in bytes per rank. Collective over comm, the file is read
+ * on rank 0 only. Without a table, or an entry point not in it, the
+ * built-in thresholds apply.
+ */
+int
+loadDecisions(const char *path, MPI_Comm comm);
+
+int
+bcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm);
+
+/* the root sends to every other rank in turn */
+int
+bcastLinear(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm);
+
+/* binomial tree rooted at root, O(log P) steps */
+int
+bcastBinomial(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm);
+
+/* segments of segment bytes pipelined down a chain of the ranks, for long messages */
+int
+bcastPipeline(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, int segment);
+
+/* binomial scatter and ring allgather, for long messages */
+int
+bcastScatterAllgather(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm);
+
+/*
+ * The *Shared variants go through the shared memory window of the comm,
+ * see shared.h, synchronizing on flags instead of messages, and fall
+ * back to a tree if the ranks are on several nodes.
+ */
+int
+bcastShared(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm);
+
+int
+bcastHierarchical(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm);
+
+int
+gather(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm);
+
+/* the root receives from every other rank in turn */
+int
+gatherLinear(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm);
+
+/* binomial tree, subtrees are sent whole and land in rbuf without a copy */
+int
+gatherBinomial(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm);
+
+int
+gatherShared(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm);
+
+int
+gatherHierarchical(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm);
+
+int
+reduce(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm);
+
+/* the root receives and combines the vector of every other rank in turn */
+int
+reduceLinear(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm);
+
+/* binomial tree combining on the way up, O(log P) steps, for short vectors */
+int
+reduceBinomial(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm);
+
+/* reduce-scatter by recursive halving then a binomial gather, for long vectors */
+int
+reduceRabenseifner(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm);
+
+/* every rank combines a slice of the vectors, for long vectors */
+int
+reduceShared(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm);
+
+int
+reduceHierarchical(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm);
+
+int
+scatter(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm);
+
+/* the root sends to every other rank in turn */
+int
+scatterLinear(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm);
+
+/* binomial tree, a rank forwards each child the blocks of the child's subtree */
+int
+scatterBinomial(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm);
+
+int
+scatterShared(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root, MPI_Comm comm);
+
+int
+allgather(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm);
+
+/* P - 1 steps passing the blocks round a ring, for long messages */
+int
+allgatherRing(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm);
+
+/* log2 P steps doubling the blocks exchanged, for short messages */
+int
+allgatherRecursiveDoubling(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm);
+
+int
+allgatherHierarchical(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm);
+
+int
+allreduce(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm);
+
+/* ring reduce-scatter then ring allgather, bandwidth optimal for long vectors */
+int
+allreduceRing(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm);
+
+/* log2 P exchanges of the whole vector, latency optimal for short ones */
+int
+allreduceRecursiveDoubling(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm);
+
+int
+allreduceHierarchical(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm);
+
+int
+alltoall(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm);
+
+/* log2 P rounds of packed blocks, for small blocks */
+int
+alltoallBruck(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm);
+
+/* P - 1 exchanges with a different peer each, for large blocks */
+int
+alltoallPairwise(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, MPI_Comm comm);
+
+/* pairwise, the counts and displacements are in elements as in MPI_Alltoallv */
+int
+alltoallv(void *sbuf, const int *scounts, const int *sdispls, MPI_Datatype stype,
+          void *rbuf, const int *rcounts, const int *rdispls, MPI_Datatype rtype, MPI_Comm comm);
+
+/* recursive halving, rank r gets block r of rcount elements of the result */
+int
+reduceScatterBlock(void *sbuf, void *rbuf, int rcount, MPI_Datatype type, MPI_Op op, MPI_Comm comm);
+
+/* inclusive prefix by recursive doubling (Hillis-Steele), ceil(log2 P) steps */
+int
+scan(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm);
+
+/* exclusive prefix, rbuf is not touched on rank 0 */
+int
+exscan(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm);
+
+/*
+ * Non-blocking binomial trees, completed by testSchedule or waitSchedule
+ * on the request, or by the progress thread, see schedule.h. The buffers
+ * must stay untouched until then.
+ */
+int
+ibcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, Schedule **request);
+
+int
+igather(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root,
+        MPI_Comm comm, Schedule **request);
+
+int
+ireduce(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm,
+        Schedule **request);
+
+int
+iscatter(void *sbuf, int scount, MPI_Datatype stype, void *rbuf, int rcount, MPI_Datatype rtype, int root,
+         MPI_Comm comm, Schedule **request);
+
+/*
+ * Persistent binomial trees, as MPI_Bcast_init and MPI_Reduce_init: the
+ * schedule, its temporaries and a persistent request per message are
+ * made once, then each startSchedule runs the collective again on the
+ * same buffers and waitSchedule completes it without freeing anything.
+ * Freed with freePersistent.
+ */
+int
+bcastInit(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, Schedule **request);
+
+int
+reduceInit(void *sbuf, void *rbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm,
+           Schedule **request);
+
+#endif
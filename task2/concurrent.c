@@ -0,0 +1,248 @@
+#include "concurrent.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define MAX_INSTANCES 64
+
+typedef struct {
+	Bench bench;
+	double time;       /* spent in the op since selectConcurrent */
+	long runs;
+} Instance;
+
+typedef struct {
+	struct Concurrent *concurrent;
+	Instance *instance;
+} Worker;
+
+struct Concurrent {
+	Concurrency mode;
+	int n;
+	const Benchmark *benchmark;
+	Instance instances[MAX_INSTANCES];
+
+	/* threads mode: the main thread runs instance 0, the workers the others */
+	pthread_t ids[MAX_INSTANCES];
+	Worker workers[MAX_INSTANCES];
+	pthread_barrier_t started, done;
+	int quit;
+};
+
+static void
+runInstance(Concurrent *concurrent, Instance *instance)
+{
+	double start = MPI_Wtime();
+	concurrent->benchmark->run(&instance->bench);
+	instance->time += MPI_Wtime() - start;
+	instance->runs++;
+}
+
+/* the barriers order the writes of the main thread before the reads of the workers */
+static void *
+work(void *arg)
+{
+	Worker *worker = (Worker *)arg;
+	Concurrent *concurrent = worker->concurrent;
+
+	for (;;) {
+		pthread_barrier_wait(&concurrent->started);
+		if (concurrent->quit) {
+			break;
+		}
+		runInstance(concurrent, worker->instance);
+		pthread_barrier_wait(&concurrent->done);
+	}
+	return NULL;
+}
+
+static void
+freeInstances(Concurrent *concurrent)
+{
+	for (int i = 0; i < concurrent->n; i++) {
+		Instance *instance = &concurrent->instances[i];
+		if (instance->bench.comm != MPI_COMM_NULL) {
+			MPI_Comm_free(&instance->bench.comm);
+		}
+		free(instance->bench.sbuf);
+		free(instance->bench.rbuf);
+	}
+}
+
+Concurrent *
+startConcurrent(const Bench *bench, int instances, Concurrency mode)
+{
+	if (instances < 1 || instances > MAX_INSTANCES) {
+		return NULL;
+	}
+
+	Concurrent *concurrent = (Concurrent *)calloc(1, sizeof(Concurrent));
+	if (!concurrent) {
+		return NULL;
+	}
+	concurrent->mode = mode;
+	concurrent->n = instances;
+
+	int ok = 1;
+	for (int i = 0; i < instances; i++) {
+		Instance *instance = &concurrent->instances[i];
+		instance->bench = *bench;
+		instance->bench.concurrent = NULL;
+		instance->bench.sbuf = (char *)calloc(bench->bytes, sizeof(char));
+		instance->bench.rbuf = (char *)calloc(bench->bytes, sizeof(char));
+		ok = ok && instance->bench.sbuf && instance->bench.rbuf;
+		MPI_Comm_dup(bench->comm, &instance->bench.comm);
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, bench->comm);
+	if (!ok) {
+		freeInstances(concurrent);
+		free(concurrent);
+		return NULL;
+	}
+
+	if (mode == ConcurrencyThreads) {
+		pthread_barrier_init(&concurrent->started, NULL, instances);
+		pthread_barrier_init(&concurrent->done, NULL, instances);
+		for (int i = 1; i < instances; i++) {
+			concurrent->workers[i].concurrent = concurrent;
+			concurrent->workers[i].instance = &concurrent->instances[i];
+			pthread_create(&concurrent->ids[i], NULL, work, &concurrent->workers[i]);
+		}
+	}
+
+	return concurrent;
+}
+
+void
+stopConcurrent(Concurrent *concurrent)
+{
+	if (!concurrent) {
+		return;
+	}
+
+	if (concurrent->mode == ConcurrencyThreads) {
+		concurrent->quit = 1;
+		pthread_barrier_wait(&concurrent->started);
+		for (int i = 1; i < concurrent->n; i++) {
+			pthread_join(concurrent->ids[i], NULL);
+		}
+		pthread_barrier_destroy(&concurrent->started);
+		pthread_barrier_destroy(&concurrent->done);
+	}
+
+	freeInstances(concurrent);
+	free(concurrent);
+}
+
+int
+canRunConcurrent(const Concurrent *concurrent, const Benchmark *benchmark)
+{
+	return concurrent->mode == ConcurrencyThreads || benchmark->post || benchmark->postSchedule;
+}
+
+void
+selectConcurrent(Concurrent *concurrent, const Benchmark *benchmark)
+{
+	concurrent->benchmark = benchmark;
+	for (int i = 0; i < concurrent->n; i++) {
+		concurrent->instances[i].time = 0;
+		concurrent->instances[i].runs = 0;
+	}
+}
+
+/* posts every instance, then takes the time of each as it completes */
+static int
+postAll(Concurrent *concurrent)
+{
+	MPI_Request requests[MAX_INSTANCES];
+	int error = MPI_SUCCESS;
+
+	double start = MPI_Wtime();
+	for (int i = 0; i < concurrent->n; i++) {
+		concurrent->benchmark->post(&concurrent->instances[i].bench, &requests[i]);
+	}
+
+	for (int left = concurrent->n; left > 0 && error == MPI_SUCCESS; left--) {
+		int i = 0;
+		error = MPI_Waitany(concurrent->n, requests, &i, MPI_STATUS_IGNORE);
+		concurrent->instances[i].time += MPI_Wtime() - start;
+		concurrent->instances[i].runs++;
+	}
+	return error;
+}
+
+/* the same for the custom ops, whose schedules are tested in turn as there is no waitany */
+static int
+postAllSchedules(Concurrent *concurrent)
+{
+	Schedule *requests[MAX_INSTANCES];
+	int done[MAX_INSTANCES] = {0};
+	int error = MPI_SUCCESS;
+
+	double start = MPI_Wtime();
+	int posted = 0;
+	for (; posted < concurrent->n && error == MPI_SUCCESS; posted++) {
+		error = concurrent->benchmark->postSchedule(&concurrent->instances[posted].bench, &requests[posted]);
+	}
+	/* after a failure, the ones posted before it still have to complete */
+	if (error != MPI_SUCCESS) {
+		posted--;
+	}
+	for (int i = posted; i < concurrent->n; i++) {
+		done[i] = 1;
+	}
+
+	for (int left = posted; left > 0;) {
+		for (int i = 0; i < concurrent->n; i++) {
+			if (done[i]) {
+				continue;
+			}
+			int ret = testSchedule(&requests[i], &done[i]);
+			if (done[i]) {
+				concurrent->instances[i].time += MPI_Wtime() - start;
+				concurrent->instances[i].runs++;
+				error = error == MPI_SUCCESS ? ret : error;
+				left--;
+			}
+		}
+		if (left > 0) {
+			sched_yield();
+		}
+	}
+	return error;
+}
+
+int
+runConcurrent(Bench *bench)
+{
+	Concurrent *concurrent = bench->concurrent;
+
+	for (int i = 0; i < concurrent->n; i++) {
+		concurrent->instances[i].bench.count = bench->count;
+	}
+	bench->messages = concurrent->n;
+
+	if (concurrent->mode == ConcurrencyNonblocking) {
+		return concurrent->benchmark->post ? postAll(concurrent) : postAllSchedules(concurrent);
+	}
+
+	pthread_barrier_wait(&concurrent->started);
+	runInstance(concurrent, &concurrent->instances[0]);
+	pthread_barrier_wait(&concurrent->done);
+
+	return MPI_SUCCESS;
+}
+
+double
+concurrentLatency(const Concurrent *concurrent)
+{
+	double time = 0;
+	long runs = 0;
+
+	for (int i = 0; i < concurrent->n; i++) {
+		time += concurrent->instances[i].time;
+		runs += concurrent->instances[i].runs;
+	}
+	return runs ? time / runs : 0;
+}
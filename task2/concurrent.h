@@ -0,0 +1,40 @@
+#ifndef __CONCURRENT_H__
+#define __CONCURRENT_H__
+
+#include "bench.h"
+
+/*
+ * Several instances of an op in flight at once, each on its own
+ * duplicate of the comm with its own buffers: run by as many threads,
+ * which needs MPI_THREAD_MULTIPLE, or posted together if the op is
+ * non-blocking.
+ */
+typedef enum {
+	ConcurrencyThreads = 0,
+	ConcurrencyNonblocking,
+} Concurrency;
+
+/* collective over bench->comm, the instances get buffers as large as bench's */
+Concurrent *
+startConcurrent(const Bench *bench, int instances, Concurrency mode);
+
+void
+stopConcurrent(Concurrent *concurrent);
+
+/* whether the mode can run benchmark, non-blocking needs a post function */
+int
+canRunConcurrent(const Concurrent *concurrent, const Benchmark *benchmark);
+
+/* selects the op of the next series and resets the per-op latency */
+void
+selectConcurrent(Concurrent *concurrent, const Benchmark *benchmark);
+
+/* the series body: every instance runs the op once on bench->count bytes */
+int
+runConcurrent(Bench *bench);
+
+/* mean time of a single instance on the calling rank since selectConcurrent */
+double
+concurrentLatency(const Concurrent *concurrent);
+
+#endif
@@ -0,0 +1,80 @@
+#include "datatype.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* of the copies between two types with gaps, which go through MPI_COMM_SELF */
+#define COPY_TAG 0
+
+int
+isContiguous(MPI_Datatype type)
+{
+	MPI_Aint lb = 0, extent = 0, trueLb = 0, trueExtent = 0;
+	int size = 0;
+
+	MPI_Type_size(type, &size);
+	MPI_Type_get_extent(type, &lb, &extent);
+	MPI_Type_get_true_extent(type, &trueLb, &trueExtent);
+	return size == extent && trueLb == 0 && trueExtent == extent;
+}
+
+MPI_Aint
+typedBytes(int count, MPI_Datatype type, MPI_Aint *lb)
+{
+	MPI_Aint ignored = 0, extent = 0, trueExtent = 0;
+
+	MPI_Type_get_extent(type, &ignored, &extent);
+	MPI_Type_get_true_extent(type, lb, &trueExtent);
+	return count > 0 ? (count - 1) * extent + trueExtent : 0;
+}
+
+char *
+allocTyped(int count, MPI_Datatype type)
+{
+	MPI_Aint lb = 0;
+	MPI_Aint bytes = typedBytes(count, type, &lb);
+
+	char *raw = (char *)malloc(bytes > 0 ? bytes : 1);
+	return raw ? raw - lb : NULL;
+}
+
+void
+freeTyped(char *buf, MPI_Datatype type)
+{
+	MPI_Aint lb = 0;
+
+	if (buf) {
+		typedBytes(1, type, &lb);
+		free(buf + lb);
+	}
+}
+
+/*
+ * The packed form of MPI_Pack is the bytes of the elements one after the
+ * other on a homogeneous machine, i.e. the buffer of a contiguous type.
+ */
+int
+copyTyped(const void *src, int scount, MPI_Datatype stype, void *dst, int rcount, MPI_Datatype rtype)
+{
+	int ssize = 0, position = 0;
+
+	if (src == dst && scount == rcount && stype == rtype) {
+		return MPI_SUCCESS;
+	}
+	MPI_Type_size(stype, &ssize);
+
+	int bytes = scount * ssize;
+	if (isContiguous(rtype)) {
+		if (isContiguous(stype)) {
+			if (dst != src) {
+				memcpy(dst, src, bytes);
+			}
+			return MPI_SUCCESS;
+		}
+		return MPI_Pack(src, scount, stype, dst, bytes, &position, MPI_COMM_SELF);
+	}
+	if (isContiguous(stype)) {
+		return MPI_Unpack(src, bytes, &position, dst, rcount, rtype, MPI_COMM_SELF);
+	}
+	return MPI_Sendrecv(src, scount, stype, 0, COPY_TAG, dst, rcount, rtype, 0, COPY_TAG,
+	                    MPI_COMM_SELF, MPI_STATUS_IGNORE);
+}
@@ -0,0 +1,36 @@
+#ifndef __DATATYPE_H__
+#define __DATATYPE_H__
+
+#include <mpi.h>
+
+/* whether count elements of type are a single run of bytes from the buffer, as for the basic types */
+int
+isContiguous(MPI_Datatype type);
+
+/*
+ * Bytes from the first to the last byte count elements of type touch,
+ * i.e. the true extent of the last element past count - 1 extents, and
+ * the true lower bound of the first in *lb. A buffer of that many bytes
+ * minus *lb holds count elements laid out as in any other, even for
+ * resized types whose elements overlap or start below the address.
+ */
+MPI_Aint
+typedBytes(int count, MPI_Datatype type, MPI_Aint *lb);
+
+/* a buffer of typedBytes(count, type), NULL if out of memory, freed with freeTyped */
+char *
+allocTyped(int count, MPI_Datatype type);
+
+void
+freeTyped(char *buf, MPI_Datatype type);
+
+/*
+ * scount elements of stype at src to rcount of rtype at dst, of the same
+ * type signature. A memcpy if both are contiguous, otherwise a single
+ * pass packing or unpacking, so either side may be MPI_BYTE for the bytes
+ * of a contiguous copy. Nothing to do if both are the same buffer.
+ */
+int
+copyTyped(const void *src, int scount, MPI_Datatype stype, void *dst, int rcount, MPI_Datatype rtype);
+
+#endif
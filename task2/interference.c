@@ -0,0 +1,153 @@
+#include "interference.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define MAX_THREADS 64
+#define CHUNK       (64 * 1024)
+
+typedef struct {
+	Load load;
+	long n;            /* doubles per array */
+	double *a, *b, *c;
+	atomic_int *stop;
+} Task;
+
+struct Interference {
+	int threads;
+	atomic_int stop;
+	pthread_t ids[MAX_THREADS];
+	Task tasks[MAX_THREADS];
+};
+
+const char *
+loadName(Load load)
+{
+	switch (load) {
+		case LoadMemory:
+			return "memory";
+		case LoadCompute:
+			return "compute";
+		default:
+			return "none";
+	}
+}
+
+static void
+triad(Task *task)
+{
+	const double scalar = 3.0;
+
+	while (!atomic_load_explicit(task->stop, memory_order_relaxed)) {
+		for (long i = 0; i < task->n; i += CHUNK) {
+			long end = i + CHUNK < task->n ? i + CHUNK : task->n;
+			for (long j = i; j < end; j++) {
+				task->a[j] = task->b[j] + scalar * task->c[j];
+			}
+			if (atomic_load_explicit(task->stop, memory_order_relaxed)) {
+				break;
+			}
+		}
+	}
+}
+
+static void
+spinner(Task *task)
+{
+	volatile double sink = 0;
+	double x = 1;
+
+	while (!atomic_load_explicit(task->stop, memory_order_relaxed)) {
+		for (int i = 0; i < CHUNK; i++) {
+			x = x * 0.999999 + 0.000001;
+		}
+	}
+	sink = x;
+	(void)sink;
+}
+
+static void *
+run(void *arg)
+{
+	Task *task = (Task *)arg;
+
+	if (task->load == LoadMemory) {
+		triad(task);
+	} else {
+		spinner(task);
+	}
+	return NULL;
+}
+
+static void
+freeTasks(Interference *interference, int n)
+{
+	for (int t = 0; t < n; t++) {
+		free(interference->tasks[t].a);
+		free(interference->tasks[t].b);
+		free(interference->tasks[t].c);
+	}
+}
+
+Interference *
+startInterference(Load load, int threads, long bytes)
+{
+	if (threads < 1 || threads > MAX_THREADS) {
+		return NULL;
+	}
+
+	Interference *interference = (Interference *)calloc(1, sizeof(Interference));
+	if (!interference) {
+		return NULL;
+	}
+	atomic_init(&interference->stop, 0);
+
+	for (int t = 0; t < threads; t++) {
+		Task *task = &interference->tasks[t];
+		task->load = load;
+		task->stop = &interference->stop;
+
+		if (load == LoadMemory) {
+			task->n = bytes / (3 * sizeof(double));
+			task->a = (double *)malloc(task->n * sizeof(double));
+			task->b = (double *)malloc(task->n * sizeof(double));
+			task->c = (double *)malloc(task->n * sizeof(double));
+			if (!task->a || !task->b || !task->c) {
+				freeTasks(interference, t + 1);
+				free(interference);
+				return NULL;
+			}
+			/* touched first here, so the pages are mapped before the timing */
+			for (long i = 0; i < task->n; i++) {
+				task->a[i] = 0, task->b[i] = 1, task->c[i] = 2;
+			}
+		}
+	}
+
+	for (int t = 0; t < threads; t++) {
+		if (pthread_create(&interference->ids[t], NULL, run, &interference->tasks[t]) != 0) {
+			interference->threads = t;
+			stopInterference(interference);
+			return NULL;
+		}
+	}
+	interference->threads = threads;
+
+	return interference;
+}
+
+void
+stopInterference(Interference *interference)
+{
+	if (!interference) {
+		return;
+	}
+
+	atomic_store(&interference->stop, 1);
+	for (int t = 0; t < interference->threads; t++) {
+		pthread_join(interference->ids[t], NULL);
+	}
+
+	freeTasks(interference, MAX_THREADS);
+	free(interference);
+}
@@ -0,0 +1,24 @@
+#ifndef __INTERFERENCE_H__
+#define __INTERFERENCE_H__
+
+/* background load the ranks run while the collectives are timed */
+typedef enum {
+	LoadNone = 0,
+	LoadMemory,    /* STREAM triad over arrays far larger than the caches */
+	LoadCompute,   /* floating point chain out of registers */
+} Load;
+
+const char *
+loadName(Load load);
+
+typedef struct Interference Interference;
+
+/* starts threads threads of load, bytes is the footprint of each memory one */
+Interference *
+startInterference(Load load, int threads, long bytes);
+
+/* stops and joins the threads */
+void
+stopInterference(Interference *interference);
+
+#endif
@@ -0,0 +1,57 @@
+#include "kernel.h"
+#include <mpi.h>
+
+static volatile double sink;
+static double iterationsPerSecond;
+
+void
+spin(long iterations)
+{
+	double x = sink;
+	for (long i = 0; i < iterations; i++) {
+		x = x * 0.999999 + 0.000001;
+	}
+	sink = x;
+}
+
+#define CALIBRATION_TIME 0.01
+#define CALIBRATION_RUNS 5
+
+/* the fastest of a few runs long enough for MPI_Wtime */
+void
+calibrate(void)
+{
+	long iterations = 1024;
+	double elapsed = 0;
+
+	do {
+		iterations *= 2;
+		double start = MPI_Wtime();
+		spin(iterations);
+		elapsed = MPI_Wtime() - start;
+	} while (elapsed < CALIBRATION_TIME);
+
+	for (int run = 0; run < CALIBRATION_RUNS; run++) {
+		double start = MPI_Wtime();
+		spin(iterations);
+		double time = MPI_Wtime() - start;
+		elapsed = time < elapsed ? time : elapsed;
+	}
+
+	iterationsPerSecond = iterations / elapsed;
+}
+
+long
+iterations(double seconds)
+{
+	if (iterationsPerSecond == 0) {
+		calibrate();
+	}
+	return (long)(seconds * iterationsPerSecond);
+}
+
+void
+compute(double seconds)
+{
+	spin(iterations(seconds));
+}
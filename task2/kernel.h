@@ -0,0 +1,25 @@
+#ifndef __KERNEL_H__
+#define __KERNEL_H__
+
+/*
+ * Calibrated compute kernel: a dependent chain of floating point
+ * operations that does not touch memory, so it only competes with
+ * communication for the core.
+ */
+
+/* measures the kernel speed on the calling core, called once per process */
+void
+calibrate(void);
+
+void
+spin(long iterations);
+
+/* iterations of spin that take about seconds, calibrating first if needed */
+long
+iterations(double seconds);
+
+/* spins for about seconds */
+void
+compute(double seconds);
+
+#endif
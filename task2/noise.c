@@ -0,0 +1,141 @@
+#include "noise.h"
+#include "kernel.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+
+#define DETOUR_THRESHOLD 0.1
+#define FTQ_CHUNKS       100
+
+static void
+fixedWork(double *durations, int samples, double quantum)
+{
+	long work = iterations(quantum);
+
+	for (int s = 0; s < samples; s++) {
+		double start = MPI_Wtime();
+		spin(work);
+		durations[s] = MPI_Wtime() - start;
+	}
+}
+
+/* the quanta are laid on a fixed grid, so a detour doesn't shift the next ones */
+static void
+fixedTime(double *counts, int samples, double quantum)
+{
+	long chunk = iterations(quantum / FTQ_CHUNKS);
+	double start = MPI_Wtime();
+
+	for (int s = 0; s < samples; s++) {
+		double end = start + (s + 1) * quantum;
+		long count = 0;
+		while (MPI_Wtime() < end) {
+			spin(chunk);
+			count++;
+		}
+		counts[s] = count;
+	}
+}
+
+static void
+summarizeWork(const double *durations, int samples, Noise *noise)
+{
+	double total = 0;
+
+	noise->quantum = INFINITY;
+	for (int s = 0; s < samples; s++) {
+		noise->quantum = durations[s] < noise->quantum ? durations[s] : noise->quantum;
+		total += durations[s];
+	}
+
+	for (int s = 0; s < samples; s++) {
+		double detour = durations[s] - noise->quantum;
+		noise->lost += detour;
+		if (detour > DETOUR_THRESHOLD * noise->quantum) {
+			noise->detours++;
+		}
+
+		/* insertion into the descending list of the worst ones */
+		for (int d = 0; d < MAX_DETOURS; d++) {
+			if (detour > noise->worst[d]) {
+				memmove(&noise->worst[d + 1], &noise->worst[d], (MAX_DETOURS - d - 1) * sizeof(double));
+				noise->worst[d] = detour;
+				break;
+			}
+		}
+	}
+	noise->lost = total > 0 ? noise->lost / total : 0;
+}
+
+/* the strongest frequencies of the power spectrum of the counts, by a plain DFT */
+static void
+summarizeTime(const double *counts, int samples, double quantum, Noise *noise)
+{
+	double best = 0, total = 0, power[MAX_PEAKS] = {0};
+
+	for (int s = 0; s < samples; s++) {
+		best = counts[s] > best ? counts[s] : best;
+		total += counts[s];
+	}
+	noise->ftqLost = best > 0 ? 1 - total / (best * samples) : 0;
+
+	double mean = total / samples;
+	for (int f = 1; f <= samples / 2; f++) {
+		double re = 0, im = 0;
+		for (int s = 0; s < samples; s++) {
+			double phase = 2 * M_PI * f * s / samples;
+			re += (counts[s] - mean) * cos(phase);
+			im -= (counts[s] - mean) * sin(phase);
+		}
+
+		double p = re * re + im * im;
+		for (int k = 0; k < MAX_PEAKS; k++) {
+			if (p > power[k]) {
+				memmove(&power[k + 1], &power[k], (MAX_PEAKS - k - 1) * sizeof(double));
+				memmove(&noise->peaks[k + 1], &noise->peaks[k], (MAX_PEAKS - k - 1) * sizeof(double));
+				power[k] = p;
+				noise->peaks[k] = f / (samples * quantum);
+				break;
+			}
+		}
+	}
+}
+
+int
+measureNoise(int samples, double quantum, Noise *noise)
+{
+	memset(noise, 0, sizeof(*noise));
+
+	double *buf = (double *)malloc(samples * sizeof(double));
+	if (!buf) {
+		return 0;
+	}
+
+	fixedWork(buf, samples, quantum);
+	summarizeWork(buf, samples, noise);
+
+	fixedTime(buf, samples, quantum);
+	summarizeTime(buf, samples, quantum, noise);
+
+	free(buf);
+	return 1;
+}
+
+double
+correlation(const double *x, const double *y, int n)
+{
+	double mx = 0, my = 0, sxy = 0, sxx = 0, syy = 0;
+
+	for (int i = 0; i < n; i++) {
+		mx += x[i] / n;
+		my += y[i] / n;
+	}
+	for (int i = 0; i < n; i++) {
+		sxy += (x[i] - mx) * (y[i] - my);
+		sxx += (x[i] - mx) * (x[i] - mx);
+		syy += (y[i] - my) * (y[i] - my);
+	}
+
+	return sxx > 0 && syy > 0 ? sxy / sqrt(sxx * syy) : 0;
+}
@@ -0,0 +1,32 @@
+#ifndef __NOISE_H__
+#define __NOISE_H__
+
+/*
+ * OS noise as seen by the calling process: fixed work quanta (FWQ) time
+ * the same amount of work over and over, fixed time quanta (FTQ) count
+ * the work done in back-to-back intervals of the same length. Any time
+ * above the shortest FWQ quantum, or work below the best FTQ one, was
+ * taken by something else.
+ */
+
+#define MAX_DETOURS 5
+#define MAX_PEAKS   3
+
+typedef struct {
+	double quantum;               /* shortest FWQ quantum */
+	double lost;                  /* FWQ time above the shortest quantum over the total */
+	int detours;                  /* FWQ quanta longer than the shortest by over 10% */
+	double worst[MAX_DETOURS];    /* longest detours, descending */
+	double ftqLost;               /* FTQ work below the best quantum over the total */
+	double peaks[MAX_PEAKS];      /* frequencies of the strongest FTQ components, Hz */
+} Noise;
+
+/* runs samples quanta of FWQ then of FTQ, both of about quantum seconds */
+int
+measureNoise(int samples, double quantum, Noise *noise);
+
+/* Pearson's correlation coefficient, 0 if either side is constant */
+double
+correlation(const double *x, const double *y, int n);
+
+#endif
@@ -0,0 +1,108 @@
+#include "reduction.h"
+#include <stddef.h>
+
+/*
+ * One plain loop per (type, op) over restrict pointers, with no branch
+ * but the op itself, so the compiler can vectorize each of them (-O3).
+ */
+#define REDUCTION_IMPLEMENTATION(name, T, expr)            \
+static void                                                \
+name(void *inoutv, const void *inv, int count)             \
+{                                                          \
+	T *restrict inout = (T *)inoutv;                       \
+	const T *restrict in = (const T *)inv;                 \
+	for (int i = 0; i < count; i++) {                      \
+		T a = inout[i], b = in[i];                         \
+		inout[i] = (expr);                                 \
+	}                                                      \
+}
+
+/* MPI_SUM, MPI_PROD, MPI_MIN and MPI_MAX, valid on every type */
+#define ARITHMETIC_IMPLEMENTATION(suffix, T)               \
+REDUCTION_IMPLEMENTATION(sum##suffix,  T, a + b)           \
+REDUCTION_IMPLEMENTATION(prod##suffix, T, a * b)           \
+REDUCTION_IMPLEMENTATION(min##suffix,  T, a < b ? a : b)   \
+REDUCTION_IMPLEMENTATION(max##suffix,  T, a > b ? a : b)
+
+/* the logical and bitwise ones, integer types only */
+#define INTEGER_IMPLEMENTATION(suffix, T)                  \
+ARITHMETIC_IMPLEMENTATION(suffix, T)                       \
+REDUCTION_IMPLEMENTATION(land##suffix, T, a && b)          \
+REDUCTION_IMPLEMENTATION(lor##suffix,  T, a || b)          \
+REDUCTION_IMPLEMENTATION(lxor##suffix, T, !a != !b)        \
+REDUCTION_IMPLEMENTATION(band##suffix, T, a & b)           \
+REDUCTION_IMPLEMENTATION(bor##suffix,  T, a | b)           \
+REDUCTION_IMPLEMENTATION(bxor##suffix, T, a ^ b)
+
+INTEGER_IMPLEMENTATION(Char, char)
+INTEGER_IMPLEMENTATION(SignedChar, signed char)
+INTEGER_IMPLEMENTATION(UnsignedChar, unsigned char)
+INTEGER_IMPLEMENTATION(Short, short)
+INTEGER_IMPLEMENTATION(UnsignedShort, unsigned short)
+INTEGER_IMPLEMENTATION(Int, int)
+INTEGER_IMPLEMENTATION(Unsigned, unsigned)
+INTEGER_IMPLEMENTATION(Long, long)
+INTEGER_IMPLEMENTATION(UnsignedLong, unsigned long)
+INTEGER_IMPLEMENTATION(LongLong, long long)
+INTEGER_IMPLEMENTATION(UnsignedLongLong, unsigned long long)
+ARITHMETIC_IMPLEMENTATION(Float, float)
+ARITHMETIC_IMPLEMENTATION(Double, double)
+ARITHMETIC_IMPLEMENTATION(LongDouble, long double)
+#undef INTEGER_IMPLEMENTATION
+#undef ARITHMETIC_IMPLEMENTATION
+#undef REDUCTION_IMPLEMENTATION
+
+typedef struct {
+	MPI_Datatype type;
+	MPI_Op op;
+	Reduction reduction;
+} Entry;
+
+#define ARITHMETIC_ENTRIES(suffix, type)                   \
+	{type, MPI_SUM,  sum##suffix},                         \
+	{type, MPI_PROD, prod##suffix},                        \
+	{type, MPI_MIN,  min##suffix},                         \
+	{type, MPI_MAX,  max##suffix}
+
+#define INTEGER_ENTRIES(suffix, type)                      \
+	ARITHMETIC_ENTRIES(suffix, type),                      \
+	{type, MPI_LAND, land##suffix},                        \
+	{type, MPI_LOR,  lor##suffix},                         \
+	{type, MPI_LXOR, lxor##suffix},                        \
+	{type, MPI_BAND, band##suffix},                        \
+	{type, MPI_BOR,  bor##suffix},                         \
+	{type, MPI_BXOR, bxor##suffix}
+
+static const Entry entries[] = {
+	INTEGER_ENTRIES(Char, MPI_CHAR),
+	INTEGER_ENTRIES(SignedChar, MPI_SIGNED_CHAR),
+	INTEGER_ENTRIES(UnsignedChar, MPI_UNSIGNED_CHAR),
+	INTEGER_ENTRIES(Short, MPI_SHORT),
+	INTEGER_ENTRIES(UnsignedShort, MPI_UNSIGNED_SHORT),
+	INTEGER_ENTRIES(Int, MPI_INT),
+	INTEGER_ENTRIES(Unsigned, MPI_UNSIGNED),
+	INTEGER_ENTRIES(Long, MPI_LONG),
+	INTEGER_ENTRIES(UnsignedLong, MPI_UNSIGNED_LONG),
+	INTEGER_ENTRIES(LongLong, MPI_LONG_LONG),
+	INTEGER_ENTRIES(UnsignedLongLong, MPI_UNSIGNED_LONG_LONG),
+	ARITHMETIC_ENTRIES(Float, MPI_FLOAT),
+	ARITHMETIC_ENTRIES(Double, MPI_DOUBLE),
+	ARITHMETIC_ENTRIES(LongDouble, MPI_LONG_DOUBLE),
+	/* bytes are opaque, only the bitwise ops apply */
+	{MPI_BYTE, MPI_BAND, bandUnsignedChar},
+	{MPI_BYTE, MPI_BOR,  borUnsignedChar},
+	{MPI_BYTE, MPI_BXOR, bxorUnsignedChar},
+};
+#undef INTEGER_ENTRIES
+#undef ARITHMETIC_ENTRIES
+
+Reduction
+findReduction(MPI_Op op, MPI_Datatype type)
+{
+	for (size_t e = 0; e < sizeof(entries) / sizeof(*entries); e++) {
+		if (entries[e].type == type && entries[e].op == op) {
+			return entries[e].reduction;
+		}
+	}
+	return NULL;
+}
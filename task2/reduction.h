@@ -0,0 +1,17 @@
+#ifndef __REDUCTION_H__
+#define __REDUCTION_H__
+
+#include <mpi.h>
+
+/* inout[i] = inout[i] op in[i] for count elements, the buffers must not overlap */
+typedef void (*Reduction)(void *inout, const void *in, int count);
+
+/*
+ * The kernel of a predefined op on a basic type, to look up once per
+ * call rather than per element. NULL if the pair is not supported, e.g.
+ * a bitwise op on a floating point type or a user-defined op.
+ */
+Reduction
+findReduction(MPI_Op op, MPI_Datatype type);
+
+#endif
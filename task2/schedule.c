@@ -0,0 +1,500 @@
+#include "schedule.h"
+#include "datatype.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+typedef enum {
+	StepSend,
+	StepRecv,
+	StepCopy,
+	StepReduction,
+	StepRound,
+} StepKind;
+
+typedef struct {
+	StepKind kind;
+	void *buf;
+	const void *src;
+	int count;
+	MPI_Datatype type;
+	int srcCount;            /* of the source of a copy, the step's count and type are the destination's */
+	MPI_Datatype srcType;
+	int peer, tag;
+	MPI_Comm comm;
+	Reduction reduction;
+} Step;
+
+#define MAX_BUFFERS 64
+#define MAX_TYPES   4
+
+struct Schedule {
+	Step *steps;
+	int nSteps, maxSteps;
+	int next;         /* the first step not started */
+	MPI_Request *requests;
+	int first;        /* the first request of the current round */
+	int nRequests;    /* of the current round */
+	int error, done;
+
+	/* built once and started many times, with a persistent request per send and receive */
+	int persistent;
+	int nPersistent;  /* of the requests created so far */
+
+	void *buffers[MAX_BUFFERS];
+	int nBuffers;
+	MPI_Datatype types[MAX_TYPES];
+	int nTypes;
+
+	Schedule *prev, *succ;   /* in the progress thread's list */
+	int listed;
+};
+
+Schedule *
+newSchedule(void)
+{
+	return (Schedule *)calloc(1, sizeof(Schedule));
+}
+
+Schedule *
+newPersistentSchedule(void)
+{
+	Schedule *schedule = newSchedule();
+	if (schedule) {
+		schedule->persistent = 1;
+	}
+	return schedule;
+}
+
+static Step *
+addStep(Schedule *schedule, StepKind kind)
+{
+	if (schedule->nSteps == schedule->maxSteps) {
+		int max = schedule->maxSteps ? 2 * schedule->maxSteps : 16;
+		Step *more = (Step *)realloc(schedule->steps, max * sizeof(Step));
+		if (!more) {
+			schedule->error = MPI_ERR_NO_MEM;
+			return NULL;
+		}
+		schedule->steps = more;
+		schedule->maxSteps = max;
+	}
+
+	Step *step = &schedule->steps[schedule->nSteps++];
+	memset(step, 0, sizeof(*step));
+	step->kind = kind;
+	return step;
+}
+
+#define ADD_STEP(step, schedule, kind)             \
+	Step *step = addStep(schedule, kind);          \
+	if (!step) {                                   \
+		return;                                    \
+	}
+
+void
+addSend(Schedule *schedule, const void *buf, int count, MPI_Datatype type, int peer, int tag, MPI_Comm comm)
+{
+	ADD_STEP(step, schedule, StepSend);
+	step->src = buf;
+	step->count = count;
+	step->type = type;
+	step->peer = peer;
+	step->tag = tag;
+	step->comm = comm;
+}
+
+void
+addRecv(Schedule *schedule, void *buf, int count, MPI_Datatype type, int peer, int tag, MPI_Comm comm)
+{
+	ADD_STEP(step, schedule, StepRecv);
+	step->buf = buf;
+	step->count = count;
+	step->type = type;
+	step->peer = peer;
+	step->tag = tag;
+	step->comm = comm;
+}
+
+void
+addCopy(Schedule *schedule, const void *src, int scount, MPI_Datatype stype, void *dst, int rcount, MPI_Datatype rtype)
+{
+	ADD_STEP(step, schedule, StepCopy);
+	step->src = src;
+	step->srcCount = scount;
+	step->srcType = stype;
+	step->buf = dst;
+	step->count = rcount;
+	step->type = rtype;
+}
+
+void
+addReduction(Schedule *schedule, Reduction reduction, void *inout, const void *in, int count)
+{
+	ADD_STEP(step, schedule, StepReduction);
+	step->buf = inout;
+	step->src = in;
+	step->count = count;
+	step->reduction = reduction;
+}
+
+void
+addRound(Schedule *schedule)
+{
+	ADD_STEP(step, schedule, StepRound);
+}
+#undef ADD_STEP
+
+void *
+scheduleBuffer(Schedule *schedule, size_t bytes)
+{
+	void *buffer = NULL;
+	if (schedule->nBuffers < MAX_BUFFERS) {
+		buffer = malloc(bytes ? bytes : 1);
+	}
+	if (!buffer) {
+		schedule->error = MPI_ERR_NO_MEM;
+		return NULL;
+	}
+	schedule->buffers[schedule->nBuffers++] = buffer;
+	return buffer;
+}
+
+void
+scheduleType(Schedule *schedule, MPI_Datatype type)
+{
+	if (type == MPI_DATATYPE_NULL) {
+		schedule->error = MPI_ERR_TYPE;
+		return;
+	}
+	if (schedule->nTypes == MAX_TYPES) {
+		MPI_Type_free(&type);
+		schedule->error = MPI_ERR_INTERN;
+		return;
+	}
+	schedule->types[schedule->nTypes++] = type;
+}
+
+static void
+freeSchedule(Schedule *schedule)
+{
+	for (int b = 0; b < schedule->nBuffers; b++) {
+		free(schedule->buffers[b]);
+	}
+	for (int t = 0; t < schedule->nTypes; t++) {
+		MPI_Type_free(&schedule->types[t]);
+	}
+	for (int r = 0; r < schedule->nPersistent; r++) {
+		MPI_Request_free(&schedule->requests[r]);
+	}
+	free(schedule->requests);
+	free(schedule->steps);
+	free(schedule);
+}
+
+/* runs the local steps and posts the communication of the next round */
+static int
+startRound(Schedule *schedule)
+{
+	int ret = MPI_SUCCESS;
+
+	for (; schedule->next < schedule->nSteps && ret == MPI_SUCCESS; schedule->next++) {
+		Step *step = &schedule->steps[schedule->next];
+		MPI_Request *request = &schedule->requests[schedule->first + schedule->nRequests];
+
+		if (step->kind == StepRound) {
+			schedule->next++;
+			break;
+		}
+
+		switch (step->kind) {
+		case StepSend:
+			if (schedule->persistent) {
+				ret = MPI_Start(request);
+			} else {
+				ret = MPI_Isend(step->src, step->count, step->type, step->peer, step->tag, step->comm, request);
+			}
+			schedule->nRequests++;
+			break;
+		case StepRecv:
+			if (schedule->persistent) {
+				ret = MPI_Start(request);
+			} else {
+				ret = MPI_Irecv(step->buf, step->count, step->type, step->peer, step->tag, step->comm, request);
+			}
+			schedule->nRequests++;
+			break;
+		case StepCopy:
+			ret = copyTyped(step->src, step->srcCount, step->srcType, step->buf, step->count, step->type);
+			break;
+		case StepReduction:
+			step->reduction(step->buf, step->src, step->count);
+			break;
+		default:
+			break;
+		}
+	}
+	return ret;
+}
+
+/*
+ * Completes as many rounds as are ready, blocking on each one if
+ * blocking. Rounds without communication complete at once.
+ */
+static int
+progress(Schedule *schedule, int blocking)
+{
+	int ret = MPI_SUCCESS;
+
+	while (!schedule->done && ret == MPI_SUCCESS) {
+		if (schedule->nRequests > 0) {
+			MPI_Request *requests = schedule->requests + schedule->first;
+			int flag = 1;
+			if (blocking) {
+				ret = MPI_Waitall(schedule->nRequests, requests, MPI_STATUSES_IGNORE);
+			} else {
+				ret = MPI_Testall(schedule->nRequests, requests, &flag, MPI_STATUSES_IGNORE);
+			}
+			if (ret != MPI_SUCCESS || !flag) {
+				break;
+			}
+			schedule->first += schedule->nRequests;
+			schedule->nRequests = 0;
+		}
+
+		if (schedule->next == schedule->nSteps) {
+			schedule->done = 1;
+		} else {
+			ret = startRound(schedule);
+		}
+	}
+
+	if (ret != MPI_SUCCESS) {
+		schedule->error = ret;
+		schedule->done = 1;
+	}
+	return ret;
+}
+
+/* the progress thread and the schedules it looks after */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_t id;
+	int running, quit;
+	Schedule *head;
+} engine = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+static void
+unlist(Schedule *schedule)
+{
+	if (!schedule->listed) {
+		return;
+	}
+	if (schedule->prev) {
+		schedule->prev->succ = schedule->succ;
+	} else {
+		engine.head = schedule->succ;
+	}
+	if (schedule->succ) {
+		schedule->succ->prev = schedule->prev;
+	}
+	schedule->listed = 0;
+}
+
+static void *
+progressAll(void *arg)
+{
+	(void)arg;
+
+	pthread_mutex_lock(&engine.lock);
+	while (!engine.quit) {
+		if (!engine.head) {
+			pthread_cond_wait(&engine.wake, &engine.lock);
+			continue;
+		}
+
+		for (Schedule *schedule = engine.head, *succ = NULL; schedule; schedule = succ) {
+			succ = schedule->succ;
+			progress(schedule, 0);
+			if (schedule->done) {
+				unlist(schedule);
+			}
+		}
+
+		/* let the ranks sharing the core compute between polls */
+		pthread_mutex_unlock(&engine.lock);
+		sched_yield();
+		pthread_mutex_lock(&engine.lock);
+	}
+	pthread_mutex_unlock(&engine.lock);
+
+	return NULL;
+}
+
+/* the requests of the sends and receives go one after the other, in the order of their steps */
+static int
+allocateRequests(Schedule *schedule)
+{
+	schedule->requests = (MPI_Request *)malloc((schedule->nSteps + 1) * sizeof(MPI_Request));
+	return schedule->requests ? MPI_SUCCESS : MPI_ERR_NO_MEM;
+}
+
+int
+initSchedule(Schedule *schedule)
+{
+	int ret = schedule->error;
+
+	if (ret == MPI_SUCCESS) {
+		ret = allocateRequests(schedule);
+	}
+	for (int s = 0; s < schedule->nSteps && ret == MPI_SUCCESS; s++) {
+		Step *step = &schedule->steps[s];
+		MPI_Request *request = &schedule->requests[schedule->nPersistent];
+
+		if (step->kind == StepSend) {
+			ret = MPI_Send_init(step->src, step->count, step->type, step->peer, step->tag, step->comm, request);
+		} else if (step->kind == StepRecv) {
+			ret = MPI_Recv_init(step->buf, step->count, step->type, step->peer, step->tag, step->comm, request);
+		} else {
+			continue;
+		}
+		if (ret == MPI_SUCCESS) {
+			schedule->nPersistent++;
+		}
+	}
+	if (ret != MPI_SUCCESS) {
+		freeSchedule(schedule);
+	}
+	return ret;
+}
+
+int
+startSchedule(Schedule *schedule)
+{
+	int ret = schedule->error;
+
+	if (schedule->persistent) {
+		/* a failed run leaves requests in flight, so the schedule is not started again */
+		if (ret != MPI_SUCCESS) {
+			return ret;
+		}
+		schedule->next = schedule->first = schedule->nRequests = 0;
+		schedule->done = 0;
+	} else {
+		if (ret == MPI_SUCCESS) {
+			ret = allocateRequests(schedule);
+		}
+		if (ret != MPI_SUCCESS) {
+			freeSchedule(schedule);
+			return ret;
+		}
+	}
+
+	pthread_mutex_lock(&engine.lock);
+	ret = progress(schedule, 0);
+	if (engine.running && !schedule->done) {
+		schedule->prev = NULL;
+		schedule->succ = engine.head;
+		if (engine.head) {
+			engine.head->prev = schedule;
+		}
+		engine.head = schedule;
+		schedule->listed = 1;
+		pthread_cond_signal(&engine.wake);
+	}
+	pthread_mutex_unlock(&engine.lock);
+
+	return ret;
+}
+
+int
+testSchedule(Schedule **schedule, int *done)
+{
+	pthread_mutex_lock(&engine.lock);
+	progress(*schedule, 0);
+	*done = (*schedule)->done;
+	if (*done) {
+		unlist(*schedule);
+	}
+	pthread_mutex_unlock(&engine.lock);
+
+	int ret = (*schedule)->error;
+	if (*done && !(*schedule)->persistent) {
+		freeSchedule(*schedule);
+		*schedule = NULL;
+	}
+	return ret;
+}
+
+void
+freePersistent(Schedule **schedule)
+{
+	if (*schedule) {
+		freeSchedule(*schedule);
+		*schedule = NULL;
+	}
+}
+
+int
+waitSchedule(Schedule **schedule)
+{
+	int done = 0;
+	int ret = MPI_SUCCESS;
+
+	/* without the thread nobody else progresses it, so it may block in MPI */
+	pthread_mutex_lock(&engine.lock);
+	int blocking = !engine.running;
+	pthread_mutex_unlock(&engine.lock);
+
+	if (blocking) {
+		progress(*schedule, 1);
+	}
+	while (!done) {
+		ret = testSchedule(schedule, &done);
+		if (!done) {
+			sched_yield();
+		}
+	}
+	return ret;
+}
+
+int
+startProgress(void)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&engine.lock);
+	if (!engine.running) {
+		engine.quit = 0;
+		ret = pthread_create(&engine.id, NULL, progressAll, NULL);
+		engine.running = ret == 0;
+	}
+	pthread_mutex_unlock(&engine.lock);
+
+	return ret == 0 ? MPI_SUCCESS : MPI_ERR_OTHER;
+}
+
+void
+stopProgress(void)
+{
+	pthread_mutex_lock(&engine.lock);
+	if (!engine.running) {
+		pthread_mutex_unlock(&engine.lock);
+		return;
+	}
+	engine.quit = 1;
+	pthread_cond_signal(&engine.wake);
+	pthread_mutex_unlock(&engine.lock);
+
+	pthread_join(engine.id, NULL);
+
+	/* the schedules still started are progressed by test and wait again */
+	pthread_mutex_lock(&engine.lock);
+	while (engine.head) {
+		unlist(engine.head);
+	}
+	engine.running = 0;
+	pthread_mutex_unlock(&engine.lock);
+}
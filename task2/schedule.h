@@ -0,0 +1,90 @@
+#ifndef __SCHEDULE_H__
+#define __SCHEDULE_H__
+
+#include "reduction.h"
+#include <stddef.h>
+#include <mpi.h>
+
+/*
+ * The request of a non-blocking collective: a schedule of rounds of
+ * steps, sends, receives and local copies or reductions. All the steps
+ * of a round start together once the previous round has completed, the
+ * local ones first so a round may send what they produce. The schedule
+ * advances whenever it is tested or waited for, or all the time from a
+ * progress thread if one runs.
+ */
+typedef struct Schedule Schedule;
+
+/* NULL if out of memory */
+Schedule *
+newSchedule(void);
+
+/*
+ * A schedule run again on every startSchedule, with persistent requests
+ * for its sends and receives made once by initSchedule, and kept when
+ * done until freePersistent.
+ */
+Schedule *
+newPersistentSchedule(void);
+
+/*
+ * Building a schedule. A failure is kept in the schedule and returned by
+ * startSchedule, so the steps can be added without checking each one.
+ */
+void
+addSend(Schedule *schedule, const void *buf, int count, MPI_Datatype type, int peer, int tag, MPI_Comm comm);
+
+void
+addRecv(Schedule *schedule, void *buf, int count, MPI_Datatype type, int peer, int tag, MPI_Comm comm);
+
+/* see copyTyped in datatype.h */
+void
+addCopy(Schedule *schedule, const void *src, int scount, MPI_Datatype stype, void *dst, int rcount, MPI_Datatype rtype);
+
+/* inout = inout op in over count elements */
+void
+addReduction(Schedule *schedule, Reduction reduction, void *inout, const void *in, int count);
+
+/* the steps added next wait for the ones before */
+void
+addRound(Schedule *schedule);
+
+/* a buffer that lives as long as the schedule, NULL if out of memory */
+void *
+scheduleBuffer(Schedule *schedule, size_t bytes);
+
+/* a committed datatype the schedule frees when done, MPI_DATATYPE_NULL of a failed one fails it */
+void
+scheduleType(Schedule *schedule, MPI_Datatype type);
+
+/* makes the requests of a persistent schedule once built, frees the schedule on failure */
+int
+initSchedule(Schedule *schedule);
+
+/* starts the first round, frees the schedule on failure unless persistent */
+int
+startSchedule(Schedule *schedule);
+
+/* sets done and frees the schedule, setting it to NULL, once it has completed, unless persistent */
+int
+testSchedule(Schedule **schedule, int *done);
+
+/* blocks until the schedule completes, then frees it unless persistent */
+int
+waitSchedule(Schedule **schedule);
+
+/* frees a persistent schedule, which must not be in flight, and sets it to NULL */
+void
+freePersistent(Schedule **schedule);
+
+/*
+ * A thread progressing every started schedule, so they complete while
+ * the caller computes. MPI must provide MPI_THREAD_MULTIPLE.
+ */
+int
+startProgress(void);
+
+void
+stopProgress(void);
+
+#endif
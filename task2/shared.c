@@ -0,0 +1,260 @@
+#include "shared.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* of each slot, two halves of 128 KiB */
+#define SLOT_BYTES (256 * 1024)
+
+/* the flags sit on cache lines of their own so polling one does not slow down the others */
+#define FLAG_BYTES 64
+
+/* before yielding the core, which matters once the ranks outnumber the cores */
+#define SPINS 1024
+
+struct Segment {
+	MPI_Comm comm;
+	MPI_Win win;      /* MPI_WIN_NULL if the comm spans nodes */
+	int rank, size;
+	char **slots;
+	long **flags;
+	long step;        /* the last step of the chunks so far, the same on every rank */
+	long lastUse[2];  /* the last step of the last chunk through each half */
+	int half;         /* of the current chunk */
+	Segment *prev, *succ;   /* in the list of the cached ones */
+};
+
+static int keyval = MPI_KEYVAL_INVALID, finalizeKeyval = MPI_KEYVAL_INVALID;
+static pthread_once_t keyvalOnce = PTHREAD_ONCE_INIT;
+
+/* the segments cached on comms not freed yet, the newest first */
+static Segment *cached;
+static pthread_mutex_t cachedLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int
+freeSegment(MPI_Comm comm, int key, void *attr, void *extra)
+{
+	Segment *segment = (Segment *)attr;
+
+	pthread_mutex_lock(&cachedLock);
+	if (segment->prev) {
+		segment->prev->succ = segment->succ;
+	} else if (cached == segment) {
+		cached = segment->succ;
+	}
+	if (segment->succ) {
+		segment->succ->prev = segment->prev;
+	}
+	pthread_mutex_unlock(&cachedLock);
+
+	if (segment->win != MPI_WIN_NULL) {
+		MPI_Win_unlock_all(segment->win);
+		MPI_Win_free(&segment->win);
+	}
+	free(segment->slots);
+	free(segment->flags);
+	free(segment);
+	return MPI_SUCCESS;
+}
+
+/*
+ * MPI_Finalize deletes the attributes of MPI_COMM_SELF first, while MPI
+ * still works, but those of MPI_COMM_WORLD only once the windows are
+ * gone, so the segments of the comms still alive are freed from here.
+ * Newest first, the reverse of the collective creations, so the ranks
+ * free the windows of overlapping comms in the same order.
+ */
+static int
+freeCached(MPI_Comm self, int key, void *attr, void *extra)
+{
+	for (;;) {
+		pthread_mutex_lock(&cachedLock);
+		Segment *segment = cached;
+		pthread_mutex_unlock(&cachedLock);
+		if (!segment) {
+			break;
+		}
+		MPI_Comm_delete_attr(segment->comm, keyval);
+	}
+	return MPI_SUCCESS;
+}
+
+static void
+createKeyval(void)
+{
+	MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, freeSegment, &keyval, NULL);
+	MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, freeCached, &finalizeKeyval, NULL);
+	MPI_Comm_set_attr(MPI_COMM_SELF, finalizeKeyval, NULL);
+}
+
+static int
+spansNodes(MPI_Comm comm, int size, int *spans)
+{
+	MPI_Comm node = MPI_COMM_NULL;
+	int nodeSize = 0;
+
+	int ret = MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+	MPI_Comm_size(node, &nodeSize);
+	MPI_Comm_free(&node);
+
+	/* the same answer everywhere, or some ranks would wait for a window the others never allocate */
+	*spans = nodeSize < size;
+	return MPI_Allreduce(MPI_IN_PLACE, spans, 1, MPI_INT, MPI_LOR, comm);
+}
+
+static int
+allocateSegment(MPI_Comm comm, Segment *segment)
+{
+	MPI_Info info = MPI_INFO_NULL;
+	char *base = NULL;
+
+	/* each rank's slot in its own pages, first touched by the rank and so on its NUMA node */
+	MPI_Info_create(&info);
+	MPI_Info_set(info, "alloc_shared_noncontig", "true");
+	int ret = MPI_Win_allocate_shared(FLAG_BYTES + SLOT_BYTES, 1, info, comm, &base, &segment->win);
+	MPI_Info_free(&info);
+	if (ret != MPI_SUCCESS) {
+		segment->win = MPI_WIN_NULL;
+		return ret;
+	}
+
+	segment->slots = (char **)malloc(segment->size * sizeof(char *));
+	segment->flags = (long **)malloc(segment->size * sizeof(long *));
+	if (!segment->slots || !segment->flags) {
+		ret = MPI_ERR_NO_MEM;
+		goto OUT;
+	}
+
+	for (int r = 0; r < segment->size; r++) {
+		MPI_Aint bytes = 0;
+		int unit = 0;
+
+		ret = MPI_Win_shared_query(segment->win, r, &bytes, &unit, &base);
+		if (ret != MPI_SUCCESS) {
+			goto OUT;
+		}
+		segment->flags[r] = (long *)base;
+		segment->slots[r] = base + FLAG_BYTES;
+	}
+
+	*segment->flags[segment->rank] = 0;
+	ret = MPI_Win_lock_all(MPI_MODE_NOCHECK, segment->win);
+
+OUT:
+	if (ret != MPI_SUCCESS) {
+		MPI_Win_free(&segment->win);
+		segment->win = MPI_WIN_NULL;
+		return ret;
+	}
+	return MPI_Barrier(comm);
+}
+
+int
+getSegment(MPI_Comm comm, Segment **segment)
+{
+	int ret = MPI_SUCCESS;
+	int flag = 0;
+
+	*segment = NULL;
+	pthread_once(&keyvalOnce, createKeyval);
+
+	Segment *found = NULL;
+	ret = MPI_Comm_get_attr(comm, keyval, &found, &flag);
+	if (ret != MPI_SUCCESS) {
+		return ret;
+	}
+	if (flag) {
+		*segment = found->win != MPI_WIN_NULL ? found : NULL;
+		return MPI_SUCCESS;
+	}
+
+	Segment *created = (Segment *)calloc(1, sizeof(Segment));
+	if (!created) {
+		return MPI_ERR_NO_MEM;
+	}
+	created->comm = comm;
+	created->win = MPI_WIN_NULL;
+	MPI_Comm_rank(comm, &created->rank);
+	MPI_Comm_size(comm, &created->size);
+
+	int spans = 0;
+	ret = spansNodes(comm, created->size, &spans);
+	if (ret == MPI_SUCCESS && !spans) {
+		ret = allocateSegment(comm, created);
+	}
+	if (ret == MPI_SUCCESS) {
+		ret = MPI_Comm_set_attr(comm, keyval, created);
+	}
+	if (ret != MPI_SUCCESS) {
+		freeSegment(comm, keyval, created, NULL);
+		return ret;
+	}
+
+	pthread_mutex_lock(&cachedLock);
+	created->succ = cached;
+	if (cached) {
+		cached->prev = created;
+	}
+	cached = created;
+	pthread_mutex_unlock(&cachedLock);
+
+	*segment = created->win != MPI_WIN_NULL ? created : NULL;
+	return MPI_SUCCESS;
+}
+
+size_t
+chunkBytes(const Segment *segment)
+{
+	return SLOT_BYTES / 2;
+}
+
+char *
+chunkSlot(Segment *segment, int rank)
+{
+	return segment->slots[rank] + segment->half * (SLOT_BYTES / 2);
+}
+
+/*
+ * The acquire pairs with the release of postStep, so what the rank
+ * stored before posting is visible here once its flag is seen.
+ */
+static void
+waitFlag(const long *flag, long step)
+{
+	for (int spins = 0; __atomic_load_n(flag, __ATOMIC_ACQUIRE) < step; spins++) {
+		if (spins >= SPINS) {
+			sched_yield();
+		}
+	}
+}
+
+void
+waitWritable(Segment *segment)
+{
+	for (int r = 0; r < segment->size; r++) {
+		waitFlag(segment->flags[r], segment->lastUse[segment->half]);
+	}
+}
+
+void
+waitStep(Segment *segment, int rank, int step)
+{
+	waitFlag(segment->flags[rank], segment->step + step);
+}
+
+void
+postStep(Segment *segment, int step)
+{
+	__atomic_store_n(segment->flags[segment->rank], segment->step + step, __ATOMIC_RELEASE);
+}
+
+void
+nextChunk(Segment *segment, int steps)
+{
+	segment->step += steps;
+	segment->lastUse[segment->half] = segment->step;
+	segment->half ^= 1;
+}
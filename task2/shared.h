@@ -0,0 +1,52 @@
+#ifndef __SHARED_H__
+#define __SHARED_H__
+
+#include <stddef.h>
+#include <mpi.h>
+
+/*
+ * A window of MPI_Win_allocate_shared over the ranks of a comm on one
+ * node, cached on the comm and freed with it. Every rank owns a flag on
+ * a cache line of its own and a slot of two halves, which all the ranks
+ * load from and store to directly.
+ *
+ * Collectives move their data through the halves in chunks, alternating
+ * between the two so one chunk is written while the last is read. Each
+ * chunk takes a few steps, numbered on from the chunks before, and a
+ * rank sets its flag to a step once done with it, so the flags only grow
+ * and never need resetting. Every rank must go through every step.
+ */
+typedef struct Segment Segment;
+
+/*
+ * The segment of comm, created on the first call, which is collective.
+ * NULL if the ranks of comm do not share memory.
+ */
+int
+getSegment(MPI_Comm comm, Segment **segment);
+
+/* bytes of each half */
+size_t
+chunkBytes(const Segment *segment);
+
+/* the half of rank's slot the current chunk goes through */
+char *
+chunkSlot(Segment *segment, int rank);
+
+/* waits until every rank is done with the last chunk through the current half, before writing to it */
+void
+waitWritable(Segment *segment);
+
+/* waits until rank is done with step of the current chunk, counted from 1 */
+void
+waitStep(Segment *segment, int rank, int step);
+
+/* this rank is done with step of the current chunk */
+void
+postStep(Segment *segment, int step);
+
+/* the current chunk took steps steps, the next goes through the other half */
+void
+nextChunk(Segment *segment, int steps);
+
+#endif
@@ -1,21 +1,90 @@
 #!/bin/bash
 
+# a failing run stops the script before its PASS line
+set -e
+
 tests="task2 task2_2"
+sources="tester.c bench.c benchmarks.c baseline.c check.c collectives.c kernel.c topology.c noise.c interference.c concurrent.c reduction.c schedule.c tuner.c shared.c datatype.c"
 
 for test in $tests
 do
-	echo "hello"
-	if mpicc $test.c -o $test ; then
+	if mpicc -O3 $test.c $sources -o $test -lm -lpthread ; then
 		for (( N = 4; N <= 4; N += 4 ))
 		do
 			echo "=== RUN  Test2 for $test with CommSize = $N"
 			sudo mpirun -n $N ./$test
 			echo "=== PASS Test2 for $test with CommSize = $N"
+			echo "=== RUN  Test2 for $test with CommSize = $N (check)"
+			sudo mpirun -n $N ./$test --check --sizes 1,1K,64K
+			sudo mpirun -n $N ./$test --check --ranks-per-node 2 --sizes 1K
+			echo "=== PASS Test2 for $test with CommSize = $N (check)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (sweep)"
+			sudo mpirun -n $N ./$test --sweep --max-size 1M --format csv
+			echo "=== PASS Test2 for $test with CommSize = $N (sweep)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (overlap)"
+			sudo mpirun -n $N ./$test --overlap --sizes 1K,64K
+			echo "=== PASS Test2 for $test with CommSize = $N (overlap)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (bcast)"
+			sudo mpirun -n $N ./$test --ops bcast,bcast_binomial,bcast_pipeline,bcast_scatter_allgather --sizes 64K,1M,4M --segment-size 16K
+			echo "=== PASS Test2 for $test with CommSize = $N (bcast)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (gather)"
+			sudo mpirun -n $N ./$test --ops gather,gather_linear,MPI_Gather --sizes 1,1K,64K
+			echo "=== PASS Test2 for $test with CommSize = $N (gather)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (scatter)"
+			sudo mpirun -n $N ./$test --ops scatter_binomial,scatter_linear,MPI_Scatter --sizes 1,1K,64K
+			echo "=== PASS Test2 for $test with CommSize = $N (scatter)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (reduce)"
+			sudo mpirun -n $N ./$test --ops reduce,reduce_linear,reduce_binomial,reduce_rabenseifner,MPI_Reduce --sizes 1K,64K,1M
+			echo "=== PASS Test2 for $test with CommSize = $N (reduce)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (shared)"
+			sudo mpirun -n $N ./$test --ops bcast_shared,gather_shared,reduce_shared,scatter_shared,scatter --sizes 1K,64K,1M
+			echo "=== PASS Test2 for $test with CommSize = $N (shared)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (hierarchical)"
+			sudo mpirun -n $N ./$test --ranks-per-node 2 --ops bcast_hierarchical,gather_hierarchical,reduce_hierarchical,allgather_hierarchical,allreduce_hierarchical --sizes 1K,1M
+			echo "=== PASS Test2 for $test with CommSize = $N (hierarchical)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (allgather, allreduce)"
+			sudo mpirun -n $N ./$test --ops allgather,allgather_ring,allgather_recursive_doubling,MPI_Allgather,allreduce,allreduce_ring,allreduce_recursive_doubling,MPI_Allreduce --sizes 1K,64K,1M
+			echo "=== PASS Test2 for $test with CommSize = $N (allgather, allreduce)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (alltoall)"
+			sudo mpirun -n $N ./$test --ops alltoall,alltoall_bruck,alltoall_pairwise,alltoallv,MPI_Alltoall,MPI_Alltoallv --sizes 16,1K,64K
+			echo "=== PASS Test2 for $test with CommSize = $N (alltoall)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (reduce_scatter_block, scan)"
+			sudo mpirun -n $N ./$test --ops reduce_scatter_block,MPI_Reduce_scatter_block,scan,MPI_Scan,exscan,MPI_Exscan --sizes 1K,64K
+			echo "=== PASS Test2 for $test with CommSize = $N (reduce_scatter_block, scan)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (non-blocking)"
+			sudo mpirun -n $N ./$test --overlap --ops ibcast,igather,ireduce,iscatter,MPI_Ibcast --sizes 1K,64K
+			sudo mpirun -n $N ./$test --overlap --progress-thread --ops ibcast,ireduce --sizes 64K --max-loops 100
+			sudo mpirun -n $N ./$test --overlap --ops bcast_persistent,ibcast,reduce_persistent,ireduce --sizes 1K,64K
+			echo "=== PASS Test2 for $test with CommSize = $N (non-blocking)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (tune)"
+			sudo mpirun -n $N ./$test --tune-output decisions.txt --sizes 1K,64K,1M --max-loops 100
+			sudo mpirun -n $N ./$test --decisions decisions.txt --ops bcast,gather,reduce,allreduce --sizes 1K,1M
+			echo "=== PASS Test2 for $test with CommSize = $N (tune)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (p2p)"
+			sudo mpirun -n $N ./$test --ops pingpong,bandwidth,bibandwidth,multibandwidth --sweep --max-size 64K
+			echo "=== PASS Test2 for $test with CommSize = $N (p2p)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (noise)"
+			sudo mpirun -n $N ./$test --noise --sizes 1,1K
+			echo "=== PASS Test2 for $test with CommSize = $N (noise)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (interference)"
+			sudo mpirun -n $N ./$test --interference memory --sizes 1K,1M --max-loops 100
+			echo "=== PASS Test2 for $test with CommSize = $N (interference)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (concurrent)"
+			sudo mpirun -n $N ./$test --concurrent 4 --sizes 1K --max-loops 200
+			sudo mpirun -n $N ./$test --concurrent 4 --concurrency nonblocking --overlap --sizes 1K,64K
+			echo "=== PASS Test2 for $test with CommSize = $N (concurrent)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (split)"
+			sudo mpirun -n $N ./$test --ranks-per-node 2
+			echo "=== PASS Test2 for $test with CommSize = $N (split)"
+			echo "=== RUN  Test2 for $test with CommSize = $N (suite)"
+			sudo mpirun -n $N ./$test --config suite.conf --output $test.json
+			sudo mpirun -n $N ./$test --config suite.conf --baseline $test.json --threshold 0.5
+			echo "=== PASS Test2 for $test with CommSize = $N (suite)"
 		done
 	else
 		echo "Error: couldn't compile $test."
 		exit 1
 	fi
 	echo
-	rm -f $test
-done
\ No newline at end of file
+	rm -f $test $test.json
+done
@@ -0,0 +1,349 @@
+#include "tester.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+static int
+compare_doubles(const void *x, const void *y)
+{
+	double z = *(const double *)x - *(const double *)y;
+	return (z > 0) - (z < 0);
+}
+
+/* linear interpolation between the closest ranks of the sorted samples */
+static double
+percentile(const double *sorted, int n, double p)
+{
+	if (n == 0) {
+		return 0;
+	}
+
+	double pos = p * (n - 1);
+	int lo = (int)pos;
+	int hi = lo + 1 < n ? lo + 1 : lo;
+
+	return sorted[lo] + (pos - lo) * (sorted[hi] - sorted[lo]);
+}
+
+/* two-sided 95% quantiles of Student's t distribution, df = 1..30 */
+static const double T_QUANTILES[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+double
+tQuantile(int df)
+{
+	int n = sizeof(T_QUANTILES) / sizeof(*T_QUANTILES);
+	if (df < 1) {
+		return INFINITY;
+	}
+	return df <= n ? T_QUANTILES[df - 1] : 1.96;
+}
+
+#define TUKEY_FENCE 3.0
+
+/*
+ * Order statistics (min, median, p90, p99, max) are taken over all the
+ * samples so the tail stays visible. Mean, stddev and the confidence
+ * interval are taken over the samples within the Tukey "far out" fences,
+ * so a single preempted iteration does not hold the series forever.
+ */
+void
+summarize(const double *samples, int n, Stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->n = n;
+	if (n == 0) {
+		return;
+	}
+
+	double *sorted = (double *)malloc(n * sizeof(double));
+	if (!sorted) {
+		return;
+	}
+	memcpy(sorted, samples, n * sizeof(double));
+	qsort(sorted, n, sizeof(double), compare_doubles);
+
+	stats->min    = sorted[0];
+	stats->max    = sorted[n - 1];
+	stats->median = percentile(sorted, n, 0.50);
+	stats->p90    = percentile(sorted, n, 0.90);
+	stats->p99    = percentile(sorted, n, 0.99);
+
+	double q1 = percentile(sorted, n, 0.25),
+	       q3 = percentile(sorted, n, 0.75);
+	double lo = q1 - TUKEY_FENCE * (q3 - q1),
+	       hi = q3 + TUKEY_FENCE * (q3 - q1);
+
+	double sum = 0;
+	int inliers = 0;
+	for (int i = 0; i < n; i++) {
+		if (sorted[i] >= lo && sorted[i] <= hi) {
+			sum += sorted[i];
+			inliers++;
+		}
+	}
+	stats->outliers = n - inliers;
+	stats->mean = sum / inliers;
+
+	double sq = 0;
+	for (int i = 0; i < n; i++) {
+		if (sorted[i] >= lo && sorted[i] <= hi) {
+			sq += (sorted[i] - stats->mean) * (sorted[i] - stats->mean);
+		}
+	}
+	stats->stddev = inliers > 1 ? sqrt(sq / (inliers - 1)) : 0;
+	stats->ci = tQuantile(inliers - 1) * stats->stddev / sqrt(inliers);
+
+	free(sorted);
+}
+
+#define DEFAULT_WARMUP_LOOPS 10
+#define DEFAULT_MIN_LOOPS    30
+#define DEFAULT_MAX_LOOPS    10000
+#define DEFAULT_PRECISION    0.02
+
+#define LOOPS_PER_SERIES     100
+
+#define SYNC_ROUNDS 20
+#define SYNC_TAG    1000
+
+/*
+ * Cristian's algorithm against TESTER_HELPER_RANK, one rank at a time:
+ * the offset is taken from the ping-pong with the shortest round trip.
+ * Clock drift over the run is not accounted for.
+ */
+static void
+syncClocks(Tester *test)
+{
+	int flag = 0;
+	int *global = NULL;
+
+	test->clockOffset = 0;
+
+	MPI_Comm_get_attr(MPI_COMM_WORLD, MPI_WTIME_IS_GLOBAL, &global, &flag);
+	if (flag && *global) {
+		return;
+	}
+
+	for (int peer = 0; peer < test->size; peer++) {
+		if (peer == TESTER_HELPER_RANK) {
+			continue;
+		}
+
+		if (test->rank == TESTER_HELPER_RANK) {
+			for (int round = 0; round < SYNC_ROUNDS; round++) {
+				double now = 0;
+				MPI_Recv(&now, 1, MPI_DOUBLE, peer, SYNC_TAG, test->comm, MPI_STATUS_IGNORE);
+				now = MPI_Wtime();
+				MPI_Send(&now, 1, MPI_DOUBLE, peer, SYNC_TAG, test->comm);
+			}
+		} else if (test->rank == peer) {
+			double bestTrip = INFINITY;
+			for (int round = 0; round < SYNC_ROUNDS; round++) {
+				double sent = MPI_Wtime(), remote = 0;
+				MPI_Send(&sent, 1, MPI_DOUBLE, TESTER_HELPER_RANK, SYNC_TAG, test->comm);
+				MPI_Recv(&remote, 1, MPI_DOUBLE, TESTER_HELPER_RANK, SYNC_TAG, test->comm, MPI_STATUS_IGNORE);
+				double received = MPI_Wtime();
+
+				if (received - sent < bestTrip) {
+					bestTrip = received - sent;
+					test->clockOffset = remote - (sent + received) / 2;
+				}
+			}
+		}
+	}
+}
+
+#define NANO_SEC 0.000000001
+Tester *
+init(MPI_Comm comm)
+{
+	Tester *test = (Tester *)calloc(1, sizeof(Tester));
+	if (!test) {
+		return test;
+	}
+
+	test->tickTime = MPI_Wtick();
+	int prec = 0;
+	for (double t = 1; t > NANO_SEC && t > 10 * test->tickTime; t /= 10) {
+		prec++;
+	}
+	sprintf(test->timeSpec, "%%.%df", prec);
+	test->comm = comm;
+	MPI_Comm_rank(comm, &test->rank);
+	MPI_Comm_size(comm, &test->size);
+
+	test->warmupLoops = DEFAULT_WARMUP_LOOPS;
+	test->minLoops = DEFAULT_MIN_LOOPS;
+	test->maxLoops = DEFAULT_MAX_LOOPS;
+	test->precision = DEFAULT_PRECISION;
+	test->loopsPerSeries = LOOPS_PER_SERIES;
+
+	int failed = 0;
+	if (test->rank == TESTER_HELPER_RANK) {
+		test->times = (double *)calloc(2 * test->size, sizeof(double));
+		test->ranks = (RankStats *)calloc(test->size, sizeof(RankStats));
+		failed = !test->times || !test->ranks;
+	}
+	MPI_Bcast(&failed, 1, MPI_INT, TESTER_HELPER_RANK, comm);
+	if (failed) {
+		release(test);
+		return NULL;
+	}
+
+	syncClocks(test);
+
+	return test;
+}
+
+void
+release(Tester *test)
+{
+	if (test) {
+		free(test->samples);
+		free(test->times);
+		free(test->ranks);
+		free(test);
+	}
+}
+
+int
+slowestRank(const Tester *test)
+{
+	int slowest = 0;
+	for (int r = 1; r < test->size; r++) {
+		if (test->ranks[r].slowest > test->ranks[slowest].slowest) {
+			slowest = r;
+		}
+	}
+	return slowest;
+}
+
+int
+start(Tester *test, char *name)
+{
+	if (test->rank == TESTER_HELPER_RANK) {
+		if (strcmp(test->name, name) != 0 || strlen(test->name) == 0) {
+			test->loops = test->nSamples = 0;
+			memset(test->ranks, 0, test->size * sizeof(RankStats));
+			strcpy(test->name, name);
+		}
+	}
+
+	MPI_Barrier(test->comm);
+
+	test->startTime = MPI_Wtime();
+
+	return ++test->loops;
+}
+
+static int
+store(Tester *test, double sample)
+{
+	if (test->nSamples == test->maxSamples) {
+		int maxSamples = test->maxSamples ? 2 * test->maxSamples : test->minLoops;
+		double *samples = (double *)realloc(test->samples, maxSamples * sizeof(double));
+		if (!samples) {
+			return 0;
+		}
+		test->samples = samples;
+		test->maxSamples = maxSamples;
+	}
+
+	test->samples[test->nSamples++] = sample;
+	return 1;
+}
+
+#define CHECK_EVERY_LOOPS 10
+
+/*
+ * The series stops once the 95% confidence interval of the mean is within
+ * precision of the mean (or below the timer resolution), or maxLoops is hit.
+ */
+static int
+converged(Tester *test)
+{
+	if (test->nSamples >= test->maxLoops) {
+		return 1;
+	}
+	if (test->nSamples < test->minLoops || test->nSamples % CHECK_EVERY_LOOPS != 0) {
+		return 0;
+	}
+
+	summarize(test->samples, test->nSamples, &test->stats);
+
+	return test->stats.ci <= test->precision * test->stats.mean ||
+	       test->stats.ci < test->tickTime;
+}
+
+/*
+ * The sample is the time from the earliest entry to the latest exit over
+ * all the ranks, on TESTER_HELPER_RANK's clock.
+ */
+static double
+account(Tester *test)
+{
+	double entry = INFINITY, exit = -INFINITY;
+	int slowest = 0;
+
+	for (int r = 0; r < test->size; r++) {
+		if (test->times[2 * r] < entry) {
+			entry = test->times[2 * r];
+		}
+		if (test->times[2 * r + 1] > exit) {
+			exit = test->times[2 * r + 1];
+			slowest = r;
+		}
+	}
+
+	if (test->loops > test->warmupLoops) {
+		int n = test->loops - test->warmupLoops;
+		for (int r = 0; r < test->size; r++) {
+			RankStats *stats = &test->ranks[r];
+			stats->completion += (test->times[2 * r + 1] - entry - stats->completion) / n;
+			stats->skew += (test->times[2 * r] - entry - stats->skew) / n;
+		}
+		test->ranks[slowest].slowest++;
+	}
+
+	return exit - entry;
+}
+
+int
+finish(Tester *test)
+{
+	int stop = 0;
+
+	double times[2] = {
+		test->startTime + test->clockOffset,
+		MPI_Wtime() + test->clockOffset,
+	};
+
+	MPI_Gather(times, 2, MPI_DOUBLE, test->times, 2, MPI_DOUBLE, TESTER_HELPER_RANK, test->comm);
+
+	if (test->rank == TESTER_HELPER_RANK) {
+
+		double elapsedTime = account(test);
+
+		if (test->loops > test->warmupLoops) {
+			stop = !store(test, elapsedTime) || converged(test);
+		}
+
+		if (stop) {
+			summarize(test->samples, test->nSamples, &test->stats);
+		}
+
+		if (test->pause && test->loops % test->loopsPerSeries == 0) {
+			sleep(test->pause);
+		}
+	}
+
+	MPI_Bcast(&stop, 1, MPI_INT, TESTER_HELPER_RANK, test->comm);
+
+	return stop;
+}
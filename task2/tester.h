@@ -0,0 +1,80 @@
+#ifndef __TESTER_H__
+#define __TESTER_H__
+
+#include <mpi.h>
+
+/* summary of the samples of one series */
+typedef struct {
+	int n;          /* samples after warmup */
+	int outliers;   /* samples out of the Tukey fences */
+	double min, max;
+	double median, p90, p99;
+	double mean, stddev;
+	double ci;      /* half-width of the 95% confidence interval of the mean */
+} Stats;
+
+void
+summarize(const double *samples, int n, Stats *stats);
+
+/* two-sided 95% quantile of Student's t distribution */
+double
+tQuantile(int df);
+
+/* per-rank accumulations of a series, means over the samples */
+typedef struct {
+	double completion;   /* exit time since the earliest entry of the loop */
+	double skew;         /* entry time since the earliest entry of the loop */
+	int slowest;         /* loops this rank was the last to exit */
+} RankStats;
+
+#define TESTER_HELPER_RANK 0
+
+#define MAX_NAME_LEN 256
+#define MAX_SPEC_LEN 10
+typedef struct {
+	char name[MAX_NAME_LEN];
+	int loops;
+	MPI_Comm comm;
+	int rank, size;
+	double startTime;
+	double tickTime;
+	double clockOffset;  /* added to MPI_Wtime() to get TESTER_HELPER_RANK's clock */
+	char timeSpec[MAX_SPEC_LEN];
+
+	/* settings of the stopping rule */
+	int warmupLoops;
+	int minLoops;
+	int maxLoops;
+	double precision;
+	int pause;           /* seconds to sleep after every loopsPerSeries loops */
+	int loopsPerSeries;
+
+	/* samples of the current series, kept on TESTER_HELPER_RANK only */
+	double *samples;
+	int nSamples, maxSamples;
+
+	Stats stats;
+
+	/* (entry, exit) pairs of the last loop and per-rank accumulations, on TESTER_HELPER_RANK */
+	double *times;
+	RankStats *ranks;
+} Tester;
+
+/* collective over comm, estimates the clock offsets against TESTER_HELPER_RANK */
+Tester *
+init(MPI_Comm comm);
+
+int
+start(Tester *test, char *name);
+
+int
+finish(Tester *test);
+
+void
+release(Tester *test);
+
+/* rank that was most often the last to exit in the series */
+int
+slowestRank(const Tester *test);
+
+#endif
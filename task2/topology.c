@@ -0,0 +1,80 @@
+#include "topology.h"
+#include <stdlib.h>
+
+int
+splitTopology(MPI_Comm comm, int ranksPerNode, Topology *topo)
+{
+	int rank = 0, size = 0, error = MPI_SUCCESS;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+
+	topo->nodeComm = topo->leaderComm = MPI_COMM_NULL;
+	topo->nodeOf = topo->nodeRankOf = topo->members = topo->firstMember = NULL;
+
+	if (ranksPerNode > 0) {
+		error = MPI_Comm_split(comm, rank / ranksPerNode, rank, &topo->nodeComm);
+	} else {
+		error = MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &topo->nodeComm);
+	}
+	if (error != MPI_SUCCESS) {
+		return error;
+	}
+	MPI_Comm_rank(topo->nodeComm, &topo->nodeRank);
+	MPI_Comm_size(topo->nodeComm, &topo->nodeSize);
+
+	error = MPI_Comm_split(comm, topo->nodeRank == 0 ? 0 : MPI_UNDEFINED, rank, &topo->leaderComm);
+	if (error != MPI_SUCCESS) {
+		MPI_Comm_free(&topo->nodeComm);
+		return error;
+	}
+
+	int where[2] = {0, 0};
+	if (topo->leaderComm != MPI_COMM_NULL) {
+		MPI_Comm_rank(topo->leaderComm, &where[0]);
+		MPI_Comm_size(topo->leaderComm, &where[1]);
+	}
+	MPI_Bcast(where, 2, MPI_INT, 0, topo->nodeComm);
+	topo->node = where[0];
+	topo->nNodes = where[1];
+
+	topo->nodeOf = (int *)malloc(size * sizeof(int));
+	topo->nodeRankOf = (int *)malloc(size * sizeof(int));
+	topo->members = (int *)malloc(size * sizeof(int));
+	topo->firstMember = (int *)calloc(topo->nNodes + 1, sizeof(int));
+	if (!topo->nodeOf || !topo->nodeRankOf || !topo->members || !topo->firstMember) {
+		freeTopology(topo);
+		return MPI_ERR_NO_MEM;
+	}
+
+	MPI_Allgather(&topo->node, 1, MPI_INT, topo->nodeOf, 1, MPI_INT, comm);
+	MPI_Allgather(&topo->nodeRank, 1, MPI_INT, topo->nodeRankOf, 1, MPI_INT, comm);
+
+	for (int r = 0; r < size; r++) {
+		topo->firstMember[topo->nodeOf[r] + 1]++;
+	}
+	for (int n = 0; n < topo->nNodes; n++) {
+		topo->firstMember[n + 1] += topo->firstMember[n];
+	}
+	for (int r = 0; r < size; r++) {
+		topo->members[topo->firstMember[topo->nodeOf[r]] + topo->nodeRankOf[r]] = r;
+	}
+
+	return MPI_SUCCESS;
+}
+
+void
+freeTopology(Topology *topo)
+{
+	free(topo->nodeOf);
+	free(topo->nodeRankOf);
+	free(topo->members);
+	free(topo->firstMember);
+	topo->nodeOf = topo->nodeRankOf = topo->members = topo->firstMember = NULL;
+
+	if (topo->leaderComm != MPI_COMM_NULL) {
+		MPI_Comm_free(&topo->leaderComm);
+	}
+	if (topo->nodeComm != MPI_COMM_NULL) {
+		MPI_Comm_free(&topo->nodeComm);
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef __TOPOLOGY_H__
+#define __TOPOLOGY_H__
+
+#include <mpi.h>
+
+/*
+ * Two-level view of a communicator: the ranks of a node share memory,
+ * the leaders are the lowest rank of every node. Ranks keep their order
+ * in both, so rank 0 of the comm is rank 0 of its node and of the leaders.
+ */
+typedef struct {
+	MPI_Comm nodeComm;
+	MPI_Comm leaderComm;   /* MPI_COMM_NULL on the non-leaders */
+	int nodeRank, nodeSize;
+	int node;              /* index of the node, i.e. rank of its leader among the leaders */
+	int nNodes;
+
+	/* where every rank of the comm is */
+	int *nodeOf, *nodeRankOf;
+	/* the ranks of node n by node rank are members[firstMember[n]] .. members[firstMember[n + 1] - 1] */
+	int *members, *firstMember;
+} Topology;
+
+/*
+ * Collective over comm. Nodes come from MPI_Comm_split_type with
+ * MPI_COMM_TYPE_SHARED, or are emulated with groups of ranksPerNode
+ * consecutive ranks if it is positive, so a single machine can stand
+ * for several.
+ */
+int
+splitTopology(MPI_Comm comm, int ranksPerNode, Topology *topo);
+
+void
+freeTopology(Topology *topo);
+
+#endif
@@ -0,0 +1,76 @@
+#include "tuner.h"
+#include "collectives.h"
+#include <stdio.h>
+#include <string.h>
+
+/* "bcast_scatter_allgather" is variant 3 of collective 0 */
+static int
+splitVariant(const char *op, int *collective, int *variant)
+{
+	for (int t = 0; t < nTunables; t++) {
+		size_t len = strlen(tunables[t].name);
+		if (strncmp(op, tunables[t].name, len) != 0 || op[len] != '_') {
+			continue;
+		}
+		for (int v = 0; v < MAX_VARIANTS && tunables[t].variants[v]; v++) {
+			if (strcmp(op + len + 1, tunables[t].variants[v]) == 0) {
+				*collective = t;
+				*variant = v;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int
+isTunedVariant(const char *op)
+{
+	int collective = 0, variant = 0;
+	return splitVariant(op, &collective, &variant);
+}
+
+static int
+samePoint(const Result *a, int collective, const Result *b)
+{
+	int c = 0, v = 0;
+	return splitVariant(b->name, &c, &v) && c == collective && strcmp(b->scope, "world") == 0 &&
+	       a->commSize == b->commSize && a->bytes == b->bytes;
+}
+
+Error
+writeDecisions(const char *path, const Result *results, int n)
+{
+	FILE *out = fopen(path, "w");
+	if (!out) {
+		return ErrFile;
+	}
+
+	fprintf(out, "# collective comm_size bytes variant, the fastest median of each point\n");
+	for (int t = 0; t < nTunables; t++) {
+		for (int r = 0; r < n; r++) {
+			if (!samePoint(&results[r], t, &results[r])) {
+				continue;
+			}
+
+			/* the first result of each point picks the fastest of them all */
+			int first = 1, best = r;
+			for (int other = 0; other < n; other++) {
+				if (samePoint(&results[r], t, &results[other])) {
+					first = first && other >= r;
+					best = results[other].stats.median < results[best].stats.median ? other : best;
+				}
+			}
+			if (!first) {
+				continue;
+			}
+
+			int collective = 0, variant = 0;
+			splitVariant(results[best].name, &collective, &variant);
+			fprintf(out, "%s %d %d %s\n", tunables[t].name, results[r].commSize, results[r].bytes,
+			        tunables[t].variants[variant]);
+		}
+	}
+
+	return fclose(out) == 0 ? OK : ErrFile;
+}
@@ -0,0 +1,18 @@
+#ifndef __TUNER_H__
+#define __TUNER_H__
+
+#include "bench.h"
+
+/* whether op runs a variant the decision table can select, e.g. bcast_pipeline */
+int
+isTunedVariant(const char *op);
+
+/*
+ * Writes the decision table of loadDecisions: for each tuned collective,
+ * comm size and message size measured, the variant with the lowest
+ * median on the whole comm.
+ */
+Error
+writeDecisions(const char *path, const Result *results, int n);
+
+#endif